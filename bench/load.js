@@ -0,0 +1,346 @@
+#!/usr/bin/env node
+// End-to-end load generator for keytar.
+//
+// Drives lib/keytar.js with a configurable operation mix at increasing
+// concurrency levels and reports throughput, latency percentiles and
+// event-loop lag for each level. Results can be saved as a baseline and
+// later runs compared against it; see `node bench/load.js --help`.
+
+var fs = require('fs')
+var path = require('path')
+
+var USAGE = [
+  'Usage: node bench/load.js [options]',
+  '',
+  '  --concurrency LIST     Comma-separated in-flight operation counts (default 1,4,16,64)',
+  '  --duration SECONDS     Measurement time per concurrency level (default 5)',
+  '  --warmup SECONDS       Unmeasured warm-up per level (default 1)',
+  '  --mix SPEC             Operation weights, e.g. get=80,set=15,delete=3,find=2 (default get=80,set=20)',
+  '  --keys N               Number of distinct accounts to spread operations over (default 100)',
+  '  --secret-size BYTES    Size of the secrets written (default 32)',
+  '  --threadpool N         UV_THREADPOOL_SIZE for this run (default: inherited, libuv uses 4)',
+  '  --service NAME         Service name used for all entries (default keytar-bench)',
+  '  --json FILE            Also write the results as JSON to FILE',
+  '  --save-baseline FILE   Store the results as the baseline in FILE',
+  '  --baseline FILE        Compare against the baseline in FILE',
+  '  --max-regression PCT   Fail when throughput drops or p99 latency grows by more',
+  '                         than PCT percent against the baseline (default 10)',
+  ''
+].join('\n')
+
+function parseArgs(argv) {
+  var options = {
+    concurrency: [1, 4, 16, 64],
+    duration: 5,
+    warmup: 1,
+    mix: {get: 80, set: 20},
+    keys: 100,
+    secretSize: 32,
+    threadpool: null,
+    service: 'keytar-bench',
+    json: null,
+    saveBaseline: null,
+    baseline: null,
+    maxRegression: 10
+  }
+
+  for (var i = 0; i < argv.length; i++) {
+    var arg = argv[i]
+    var value = argv[i + 1]
+    switch (arg) {
+      case '--concurrency': options.concurrency = value.split(',').map(Number); i++; break
+      case '--duration': options.duration = Number(value); i++; break
+      case '--warmup': options.warmup = Number(value); i++; break
+      case '--mix': options.mix = parseMix(value); i++; break
+      case '--keys': options.keys = Number(value); i++; break
+      case '--secret-size': options.secretSize = Number(value); i++; break
+      case '--threadpool': options.threadpool = Number(value); i++; break
+      case '--service': options.service = value; i++; break
+      case '--json': options.json = value; i++; break
+      case '--save-baseline': options.saveBaseline = value; i++; break
+      case '--baseline': options.baseline = value; i++; break
+      case '--max-regression': options.maxRegression = Number(value); i++; break
+      case '--help':
+        process.stdout.write(USAGE)
+        process.exit(0)
+        break
+      default:
+        process.stderr.write('Unknown option: ' + arg + '\n\n' + USAGE)
+        process.exit(2)
+    }
+  }
+
+  return options
+}
+
+function parseMix(spec) {
+  var mix = {}
+  spec.split(',').forEach(function (part) {
+    var pair = part.split('=')
+    if (['get', 'set', 'delete', 'find'].indexOf(pair[0]) === -1) {
+      throw new Error('Unknown operation in --mix: ' + pair[0])
+    }
+    mix[pair[0]] = Number(pair[1])
+  })
+  return mix
+}
+
+var options = parseArgs(process.argv.slice(2))
+
+// libuv sizes its threadpool on first use, so this has to happen before
+// keytar queues any work.
+if (options.threadpool) {
+  process.env.UV_THREADPOOL_SIZE = String(options.threadpool)
+}
+
+var keytar = require('..')
+
+function now() {
+  var time = process.hrtime()
+  return time[0] * 1e3 + time[1] / 1e6
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) {
+    return 0
+  }
+  var index = Math.min(sorted.length - 1, Math.ceil(p / 100 * sorted.length) - 1)
+  return sorted[Math.max(0, index)]
+}
+
+// Samples event-loop lag as the drift of a short interval timer. Node's
+// monitorEventLoopDelay is used instead when it is available.
+function startLagMonitor() {
+  var perfHooks = require('perf_hooks')
+  if (typeof perfHooks.monitorEventLoopDelay === 'function') {
+    var histogram = perfHooks.monitorEventLoopDelay({resolution: 10})
+    histogram.enable()
+    return function stop() {
+      histogram.disable()
+      return {
+        mean: histogram.mean / 1e6,
+        p99: histogram.percentile(99) / 1e6,
+        max: histogram.max / 1e6
+      }
+    }
+  }
+
+  var interval = 10
+  var samples = []
+  var last = now()
+  var timer = setInterval(function () {
+    var current = now()
+    samples.push(Math.max(0, current - last - interval))
+    last = current
+  }, interval)
+  return function stop() {
+    clearInterval(timer)
+    samples.sort(function (a, b) { return a - b })
+    var sum = samples.reduce(function (a, b) { return a + b }, 0)
+    return {
+      mean: samples.length ? sum / samples.length : 0,
+      p99: percentile(samples, 99),
+      max: samples.length ? samples[samples.length - 1] : 0
+    }
+  }
+}
+
+function pickOperation(mix) {
+  var total = 0
+  var names = Object.keys(mix)
+  names.forEach(function (name) { total += mix[name] })
+  var roll = Math.random() * total
+  for (var i = 0; i < names.length; i++) {
+    roll -= mix[names[i]]
+    if (roll < 0) {
+      return names[i]
+    }
+  }
+  return names[names.length - 1]
+}
+
+function account(index) {
+  return 'account-' + index
+}
+
+function runOperation(name, secret) {
+  var key = account(Math.floor(Math.random() * options.keys))
+  switch (name) {
+    case 'get': return keytar.getPassword(options.service, key)
+    case 'set': return keytar.setPassword(options.service, key, secret)
+    case 'delete': return keytar.deletePassword(options.service, key)
+    case 'find': return keytar.findPassword(options.service)
+  }
+}
+
+// Keeps `concurrency` operations in flight until `seconds` have passed and
+// returns the latency of every completed operation.
+function drive(concurrency, seconds, secret) {
+  var deadline = now() + seconds * 1000
+  var latencies = []
+  var errors = 0
+
+  function loop() {
+    if (now() >= deadline) {
+      return Promise.resolve()
+    }
+    var start = now()
+    return runOperation(pickOperation(options.mix), secret).then(function () {
+      latencies.push(now() - start)
+    }, function () {
+      errors++
+    }).then(loop)
+  }
+
+  var workers = []
+  for (var i = 0; i < concurrency; i++) {
+    workers.push(loop())
+  }
+  return Promise.all(workers).then(function () {
+    return {latencies: latencies, errors: errors}
+  })
+}
+
+async function seed(secret) {
+  for (var i = 0; i < options.keys; i++) {
+    await keytar.setPassword(options.service, account(i), secret)
+  }
+}
+
+async function cleanup() {
+  for (var i = 0; i < options.keys; i++) {
+    await keytar.deletePassword(options.service, account(i))
+  }
+}
+
+async function measure(concurrency, secret) {
+  if (options.warmup > 0) {
+    await drive(concurrency, options.warmup, secret)
+  }
+
+  var stopLag = startLagMonitor()
+  var start = now()
+  var run = await drive(concurrency, options.duration, secret)
+  var elapsed = (now() - start) / 1000
+  var lag = stopLag()
+
+  var sorted = run.latencies.sort(function (a, b) { return a - b })
+  return {
+    concurrency: concurrency,
+    operations: sorted.length,
+    errors: run.errors,
+    throughput: sorted.length / elapsed,
+    latency: {
+      p50: percentile(sorted, 50),
+      p90: percentile(sorted, 90),
+      p99: percentile(sorted, 99),
+      max: sorted.length ? sorted[sorted.length - 1] : 0
+    },
+    eventLoopLag: lag
+  }
+}
+
+function pad(value, width) {
+  var text = String(value)
+  while (text.length < width) {
+    text = ' ' + text
+  }
+  return text
+}
+
+function printResults(results) {
+  var header = [
+    pad('conc', 6), pad('ops/s', 10), pad('p50 ms', 9), pad('p90 ms', 9),
+    pad('p99 ms', 9), pad('max ms', 9), pad('lag p99', 9), pad('errors', 8)
+  ].join('')
+  console.log(header)
+  var peak = Math.max.apply(null, results.map(function (r) { return r.throughput }))
+  results.forEach(function (r) {
+    var bar = new Array(Math.round(r.throughput / (peak || 1) * 30) + 1).join('#')
+    console.log([
+      pad(r.concurrency, 6),
+      pad(r.throughput.toFixed(1), 10),
+      pad(r.latency.p50.toFixed(2), 9),
+      pad(r.latency.p90.toFixed(2), 9),
+      pad(r.latency.p99.toFixed(2), 9),
+      pad(r.latency.max.toFixed(2), 9),
+      pad(r.eventLoopLag.p99.toFixed(2), 9),
+      pad(r.errors, 8)
+    ].join('') + '  ' + bar)
+  })
+}
+
+// Returns a list of human-readable regressions of `results` against
+// `baseline`, matched by concurrency level.
+function compare(results, baseline) {
+  var limit = options.maxRegression / 100
+  var regressions = []
+  results.forEach(function (r) {
+    var base = baseline.results.filter(function (b) {
+      return b.concurrency === r.concurrency
+    })[0]
+    if (!base) {
+      return
+    }
+    if (r.throughput < base.throughput * (1 - limit)) {
+      regressions.push('concurrency ' + r.concurrency + ': throughput ' +
+        r.throughput.toFixed(1) + ' ops/s vs baseline ' + base.throughput.toFixed(1))
+    }
+    if (r.latency.p99 > base.latency.p99 * (1 + limit)) {
+      regressions.push('concurrency ' + r.concurrency + ': p99 latency ' +
+        r.latency.p99.toFixed(2) + ' ms vs baseline ' + base.latency.p99.toFixed(2))
+    }
+  })
+  return regressions
+}
+
+async function main() {
+  var secret = new Array(options.secretSize + 1).join('s')
+  var report = {
+    date: new Date().toISOString(),
+    node: process.version,
+    platform: process.platform,
+    threadpool: Number(process.env.UV_THREADPOOL_SIZE) || 4,
+    mix: options.mix,
+    keys: options.keys,
+    secretSize: options.secretSize,
+    results: []
+  }
+
+  console.log('keytar load test: mix ' + JSON.stringify(options.mix) + ', ' +
+    options.keys + ' keys, UV_THREADPOOL_SIZE=' + report.threadpool)
+
+  await seed(secret)
+  try {
+    for (var i = 0; i < options.concurrency.length; i++) {
+      report.results.push(await measure(options.concurrency[i], secret))
+    }
+  } finally {
+    await cleanup()
+  }
+
+  printResults(report.results)
+
+  if (options.json) {
+    fs.writeFileSync(options.json, JSON.stringify(report, null, 2) + '\n')
+  }
+  if (options.saveBaseline) {
+    fs.writeFileSync(options.saveBaseline, JSON.stringify(report, null, 2) + '\n')
+    console.log('Saved baseline to ' + path.resolve(options.saveBaseline))
+  }
+  if (options.baseline) {
+    var regressions = compare(report.results, JSON.parse(fs.readFileSync(options.baseline)))
+    if (regressions.length > 0) {
+      console.error('Regressed by more than ' + options.maxRegression + '% against ' + options.baseline + ':')
+      regressions.forEach(function (line) { console.error('  ' + line) })
+      process.exitCode = 1
+    } else {
+      console.log('Within ' + options.maxRegression + '% of baseline ' + options.baseline)
+    }
+  }
+}
+
+main().catch(function (err) {
+  console.error(err)
+  process.exitCode = 1
+})
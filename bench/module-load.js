@@ -0,0 +1,145 @@
+#!/usr/bin/env node
+// Module load-time benchmark for keytar.
+//
+// Starts fresh node processes that require lib/keytar.js and reports how
+// long the require itself takes, how much resident memory it adds and how
+// long the first call (which opens the platform backend) takes. Compare two
+// builds by running this against each; see `node bench/module-load.js --help`.
+
+var childProcess = require('child_process')
+var fs = require('fs')
+var path = require('path')
+
+var USAGE = [
+  'Usage: node bench/module-load.js [options]',
+  '',
+  '  --runs N               Number of fresh processes to start (default 20)',
+  '  --first-call           Also time the first getPassword call in each process',
+  '  --service NAME         Service name used by --first-call (default keytar-bench)',
+  '  --json FILE            Also write the results as JSON to FILE',
+  ''
+].join('\n')
+
+function parseArgs(argv) {
+  var options = {
+    runs: 20,
+    firstCall: false,
+    service: 'keytar-bench',
+    json: null
+  }
+
+  for (var i = 0; i < argv.length; i++) {
+    var arg = argv[i]
+    var value = argv[i + 1]
+    switch (arg) {
+      case '--runs': options.runs = Number(value); i++; break
+      case '--first-call': options.firstCall = true; break
+      case '--service': options.service = value; i++; break
+      case '--json': options.json = value; i++; break
+      case '--help':
+        process.stdout.write(USAGE)
+        process.exit(0)
+        break
+      default:
+        process.stderr.write('Unknown option: ' + arg + '\n\n' + USAGE)
+        process.exit(2)
+    }
+  }
+  return options
+}
+
+// Runs inside each child. Prints one JSON line with the measurements.
+function child(keytarPath, firstCall, service) {
+  function ms(start) {
+    var diff = process.hrtime(start)
+    return diff[0] * 1e3 + diff[1] / 1e6
+  }
+
+  var rssBefore = process.memoryUsage().rss
+  var start = process.hrtime()
+  var keytar = require(keytarPath)
+  var sample = {
+    require: ms(start),
+    rss: (process.memoryUsage().rss - rssBefore) / 1024
+  }
+
+  if (!firstCall) {
+    process.stdout.write(JSON.stringify(sample) + '\n')
+    return
+  }
+
+  start = process.hrtime()
+  keytar.getPassword(service, 'module-load').then(function () {
+    sample.firstCall = ms(start)
+  }, function (error) {
+    sample.firstCall = ms(start)
+    sample.error = error.message
+  }).then(function () {
+    process.stdout.write(JSON.stringify(sample) + '\n')
+  })
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0
+  var index = Math.min(sorted.length - 1, Math.ceil(p / 100 * sorted.length) - 1)
+  return sorted[Math.max(0, index)]
+}
+
+function summarize(values) {
+  var sorted = values.slice().sort(function (a, b) { return a - b })
+  return {
+    min: sorted[0],
+    p50: percentile(sorted, 50),
+    p95: percentile(sorted, 95),
+    max: sorted[sorted.length - 1]
+  }
+}
+
+function runOnce(options) {
+  var script = '(' + child.toString() + ')(' +
+    JSON.stringify(path.join(__dirname, '..', 'lib', 'keytar.js')) + ', ' +
+    JSON.stringify(options.firstCall) + ', ' +
+    JSON.stringify(options.service) + ')'
+  var output = childProcess.execFileSync(process.execPath, ['-e', script], {
+    encoding: 'utf8'
+  })
+  return JSON.parse(output.trim().split('\n').pop())
+}
+
+function pad(value, width) {
+  var text = typeof value === 'number' ? value.toFixed(2) : String(value)
+  while (text.length < width) text = ' ' + text
+  return text
+}
+
+function main() {
+  var options = parseArgs(process.argv.slice(2))
+  var samples = []
+  for (var i = 0; i < options.runs; i++) samples.push(runOnce(options))
+
+  var errors = samples.filter(function (s) { return s.error })
+  var results = {
+    runs: samples.length,
+    require: summarize(samples.map(function (s) { return s.require })),
+    rss: summarize(samples.map(function (s) { return s.rss }))
+  }
+  if (options.firstCall) {
+    results.firstCall = summarize(samples.map(function (s) { return s.firstCall }))
+  }
+
+  var rows = [['require (ms)', results.require], ['rss (KiB)', results.rss]]
+  if (results.firstCall) rows.push(['first call (ms)', results.firstCall])
+  process.stdout.write(pad('', 16) + pad('min', 10) + pad('p50', 10) + pad('p95', 10) + pad('max', 10) + '\n')
+  rows.forEach(function (row) {
+    var stats = row[1]
+    process.stdout.write(pad(row[0], 16) + pad(stats.min, 10) + pad(stats.p50, 10) +
+      pad(stats.p95, 10) + pad(stats.max, 10) + '\n')
+  })
+  if (errors.length > 0) {
+    process.stdout.write('\n' + errors.length + ' first call(s) failed: ' + errors[0].error + '\n')
+  }
+
+  if (options.json) fs.writeFileSync(options.json, JSON.stringify(results, null, 2) + '\n')
+}
+
+main()
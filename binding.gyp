@@ -1,14 +1,39 @@
 {
+  'variables': {
+    # Build keytar_core as 'shared_library' for native consumers that
+    # prefer to link it dynamically.
+    'keytar_core_library%': 'static_library',
+    # Set to 1 to also build the native example and tests.
+    'keytar_native_tests%': 0,
+    # Set to 0 to leave out the USDT probes in src/probes.h. They are only
+    # built on Linux, and only when <sys/sdt.h> (systemtap-sdt-dev) exists.
+    'keytar_probes%': 1,
+  },
+  'target_defaults': {
+    'conditions': [
+      ['OS=="linux" and keytar_probes==1', {
+        'defines': [ 'KEYTAR_ENABLE_PROBES' ],
+      }],
+    ],
+  },
   'targets': [
     {
-      'target_name': 'keytar',
-      'include_dirs': [ '<!(node -e "require(\'nan\')")' ],
+      # The platform backends behind the keytar:: API in src/keytar.h, plus
+      # the asynchronous API in src/native_async.h. Has no Node dependency.
+      'target_name': 'keytar_core',
+      'type': '<(keytar_core_library)',
       'sources': [
-        'src/async.cc',
-        'src/main.cc',
+        'src/native_async.cc',
+        'src/operations.cc',
         'src/keytar.h',
         'src/credentials.h',
+        'src/native_async.h',
+        'src/operations.h',
+        'src/probes.h',
       ],
+      'direct_dependent_settings': {
+        'include_dirs': [ 'src' ],
+      },
       'conditions': [
         ['OS=="mac"', {
           'sources': [
@@ -32,24 +57,114 @@
         }],
         ['OS not in ["mac", "win"]', {
           'sources': [
+            'src/keytar_keyctl.cc',
+            'src/keytar_keyctl.h',
             'src/keytar_posix.cc',
+            'src/libsecret_loader.cc',
+            'src/libsecret_loader.h',
           ],
+          # libsecret is only needed for its headers at build time; the
+          # library itself is loaded with dlopen on first use.
           'cflags': [
             '<!(pkg-config --cflags libsecret-1)',
+            '-fPIC',
             '-Wno-missing-field-initializers',
             '-Wno-deprecated-declarations',
           ],
           'link_settings': {
             'ldflags': [
-              '<!(pkg-config --libs-only-L --libs-only-other libsecret-1)',
+              '-pthread',
             ],
             'libraries': [
-              '<!(pkg-config --libs-only-l libsecret-1)',
+              '-ldl',
             ],
           },
         }],
+      ],
+    },
+    {
+      'target_name': 'keytar',
+      'include_dirs': [ '<!(node -e "require(\'nan\')")' ],
+      'dependencies': [ 'keytar_core' ],
+      'sources': [
+        'src/agent_client.cc',
+        'src/async.cc',
+        'src/credential_handle.cc',
+        'src/large_value.cc',
+        'src/main.cc',
+        'src/packed_credentials.cc',
+        'src/preload.cc',
+        'src/secret_fd.cc',
+        # Uses the OpenSSL bundled with Node, so it lives in the addon.
+        'src/transfer.cc',
+        'src/transfer_cursor.cc',
+      ],
+      'conditions': [
+        ['OS=="win"', {
+          'msvs_disabled_warnings': [
+            4267,  # conversion from 'size_t' to 'int', possible loss of data
+            4530,  # C++ exception handler used, but unwind semantics are not enabled
+            4506,  # no definition for inline function
+          ],
+        }],
+        ['OS=="linux"', {
+          'sources': [
+            'src/agent_protocol.cc',
+          ],
+        }],
         ['target_arch=="arm"', { 'type': 'static_library' }]
       ],
     }
-  ]
+  ],
+  'conditions': [
+    ['OS=="linux"', {
+      'targets': [
+        {
+          # Optional daemon sharing one Secret Service connection and cache
+          # across keytar processes; see "Agent mode" in the README.
+          'target_name': 'keytar-agent',
+          'type': 'executable',
+          'dependencies': [ 'keytar_core' ],
+          'sources': [
+            'src/agent_main.cc',
+            'src/agent_protocol.cc',
+          ],
+        },
+      ],
+    }],
+    ['keytar_native_tests==1', {
+      'targets': [
+        {
+          'target_name': 'keytar_get_password',
+          'type': 'executable',
+          'dependencies': [ 'keytar_core' ],
+          'sources': [
+            'examples/get_password.cc',
+          ],
+        },
+        {
+          'target_name': 'keytar_core_spec',
+          'type': 'executable',
+          'dependencies': [ 'keytar_core' ],
+          'sources': [
+            'spec/native/keytar_core_spec.cc',
+          ],
+        },
+      ],
+    }],
+    ['keytar_native_tests==1 and OS=="linux"', {
+      'targets': [
+        {
+          # Counts heap allocations per backend call; see
+          # spec/native/leak_check.cc.
+          'target_name': 'keytar_leak_check',
+          'type': 'executable',
+          'dependencies': [ 'keytar_core' ],
+          'sources': [
+            'spec/native/leak_check.cc',
+          ],
+        },
+      ],
+    }],
+  ],
 }
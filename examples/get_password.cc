@@ -0,0 +1,32 @@
+// Looks up a password with keytar_core from plain C++, without Node.
+//
+//   ./build/Release/keytar_get_password <service> <account>
+
+#include <iostream>
+
+#include "native_async.h"
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <service> <account>" << std::endl;
+    return 2;
+  }
+
+  // The lookup runs on keytar's executor; the calling thread is free to do
+  // other work until it needs the result.
+  std::future<keytar::PasswordResult> lookup =
+    keytar::GetPasswordAsync(argv[1], argv[2]);
+
+  keytar::PasswordResult found = lookup.get();
+  if (found.result == keytar::FAIL_ERROR) {
+    std::cerr << "Error: " << found.error << std::endl;
+    return 1;
+  } else if (found.result == keytar::FAIL_NONFATAL) {
+    std::cerr << "No password stored for " << argv[1] << "/" << argv[2]
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << found.password << std::endl;
+  return 0;
+}
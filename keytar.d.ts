@@ -1,15 +1,134 @@
 // Definitions by: Milan Burda <https://github.com/miniak>, Brendan Forster <https://github.com/shiftkey>, Hari Juturu <https://github.com/juturu>
 // Adapted from DefinitelyTyped: https://github.com/DefinitelyTyped/DefinitelyTyped/blob/master/types/keytar/index.d.ts
 
+/**
+ * Process-wide keytar settings.
+ */
+export interface KeytarConfiguration {
+  /**
+   * Window in milliseconds during which plain writes to the same service
+   * and account are collapsed into one write of the last value. 0 (the
+   * default) disables coalescing.
+   */
+  writeCoalescingWindow?: number;
+  /**
+   * Where secrets are stored: 'default' for the platform keychain, or on
+   * Linux 'keyctl' for the kernel key retention service.
+   */
+  backend?: 'default' | 'keyctl';
+  /** keyctl keyring holding the keys. Defaults to 'user'. */
+  keyring?: 'user' | 'session' | 'process';
+  /**
+   * Seconds after which keys written by the keyctl backend from now on
+   * expire. 0 (the default) keeps them until deleted or the keyring goes
+   * away.
+   */
+  keyTimeout?: number;
+  /**
+   * Milliseconds without calls after which the connection to the Secret
+   * Service is closed and what was cached for it freed. The next call
+   * reconnects. 0 (the default) keeps it open.
+   */
+  idleTimeout?: number;
+  /**
+   * Whether calls may prompt the user to unlock the keychain or a
+   * collection. When false, calls that would prompt are rejected right away
+   * with an error whose code is 'ERR_KEYTAR_LOCKED'. Defaults to true.
+   */
+  interactive?: boolean;
+}
+
+/**
+ * Change process-wide keytar settings. Settings that are not given keep
+ * their current value.
+ *
+ * @param options The settings to change.
+ */
+export declare function configure(options: KeytarConfiguration): void;
+
+/**
+ * Close the connection to the Secret Service now and free what was cached
+ * for it, once running calls have finished. The next call reconnects.
+ *
+ * @returns A promise that resolves once the connection is closed.
+ */
+export declare function release(): Promise<void>;
+
+/**
+ * Unlock collections with a single prompt before a batch of calls, even
+ * when `interactive` is false.
+ *
+ * @param collections Names of the collections to unlock. Defaults to the
+ *                    default collection.
+ *
+ * @returns A promise for true once they are unlocked, or false if the user
+ *          dismissed the prompt.
+ */
+export declare function unlock(collections?: string[]): Promise<boolean>;
+
+/**
+ * Options for values stored in large-value mode.
+ */
+export interface LargeValueOptions {
+  /** Store or read the value in large-value mode. */
+  largeValue?: boolean;
+  /** Size in bytes from which values are compressed. Defaults to 1024. */
+  compressThreshold?: number;
+}
+
+/**
+ * Options for conditional writes. A conditional write yields whether the
+ * value was written.
+ */
+export interface ConditionalWriteOptions<T> {
+  /** Skip the write when the stored value already equals the new one. */
+  ifChanged?: boolean;
+  /**
+   * Only write when the stored value equals this one, or when nothing is
+   * stored yet if `null`.
+   */
+  expected?: T | null;
+}
+
+/**
+ * Options for a single write with the keyctl backend.
+ */
+export interface KeyTimeoutOptions {
+  /**
+   * Seconds after which the key expires, overriding the keyTimeout passed
+   * to configure. 0 keeps it. Other backends reject the option.
+   */
+  keyTimeout?: number;
+}
+
+/**
+ * Options selecting a Secret Service collection other than the default one.
+ * Only supported on Linux.
+ */
+export interface CollectionOptions {
+  /** A collection alias, label or D-Bus object path. */
+  collection?: string;
+}
+
+/**
+ * Options for searches spanning several collections, which are queried
+ * concurrently. Only supported on Linux.
+ */
+export interface CollectionSearchOptions extends CollectionOptions {
+  /** Collection aliases, labels or D-Bus object paths to search. */
+  collections?: string[];
+}
+
 /**
  * Get the stored password for the service and account.
  *
  * @param service The string service name.
  * @param account The string account name.
+ * @param options Optional large-value mode or collection settings.
  *
  * @returns A promise for the password string.
  */
-export declare function getPassword(service: string, account: string): Promise<string | null>;
+export declare function getPassword(service: string, account: string, options?: LargeValueOptions | CollectionOptions): Promise<string | null>;
 
 /**
  * Add the password for the service and account to the keychain.
@@ -17,35 +136,264 @@ export declare function getPassword(service: string, account: string): Promise<s
  * @param service The string service name.
  * @param account The string account name.
  * @param password The string password.
+ * @param options Optional large-value mode, collection or key timeout
+ *                settings.
  *
  * @returns A promise for the set password completion.
  */
-export declare function setPassword(service: string, account: string, password: string): Promise<void>;
+export declare function setPassword(service: string, account: string, password: string, options?: LargeValueOptions | CollectionOptions | KeyTimeoutOptions): Promise<void>;
+export declare function setPassword(service: string, account: string, password: string, options: ConditionalWriteOptions<string>): Promise<boolean>;
+
+/**
+ * Get the stored binary secret for the service and account.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ * @param options Optional large-value mode or collection settings.
+ *
+ * @returns A promise for the secret bytes.
+ */
+export declare function getPasswordBuffer(service: string, account: string, options?: LargeValueOptions | CollectionOptions): Promise<Buffer | null>;
+
+/**
+ * Add a binary secret for the service and account to the keychain.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ * @param password The secret bytes.
+ * @param options Optional large-value mode, collection or key timeout
+ *                settings.
+ *
+ * @returns A promise for the set password completion.
+ */
+export declare function setPasswordBuffer(service: string, account: string, password: Buffer, options?: LargeValueOptions | CollectionOptions | KeyTimeoutOptions): Promise<void>;
+export declare function setPasswordBuffer(service: string, account: string, password: Buffer, options: ConditionalWriteOptions<Buffer>): Promise<boolean>;
 
 /**
  * Delete the stored password for the service and account.
  *
  * @param service The string service name.
  * @param account The string account name.
+ * @param options Optional large-value mode or collection settings.
  *
  * @returns A promise for the deletion status. True on success.
  */
-export declare function deletePassword(service: string, account: string): Promise<boolean>;
+export declare function deletePassword(service: string, account: string, options?: LargeValueOptions | CollectionOptions): Promise<boolean>;
+
+/**
+ * A service and account checked and converted once, by `handle`, for
+ * repeated calls on the same entry.
+ */
+export interface CredentialHandle {
+  readonly service: string;
+  readonly account: string;
+  /** Like `getPassword`. */
+  get(): Promise<string | null>;
+  /** Like `getPasswordBuffer`. */
+  getBuffer(): Promise<Buffer | null>;
+  /** Like `setPassword`. */
+  set(password: string): Promise<void>;
+  /** Like `setPasswordBuffer`. */
+  setBuffer(password: Buffer): Promise<void>;
+  /** Like `deletePassword`. Resolves to true if an entry was deleted. */
+  delete(): Promise<boolean>;
+}
+
+/**
+ * Prepare a handle for the service and account.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ *
+ * @returns The handle.
+ */
+export declare function handle(service: string, account: string): CredentialHandle;
 
 /**
  * Find a password for the service in the keychain.
  *
  * @param service The string service name.
+ * @param options Optional collection to search instead of the default one.
  *
  * @returns A promise for the password string.
  */
-export declare function findPassword(service: string): Promise<string | null>;
+export declare function findPassword(service: string, options?: CollectionOptions): Promise<string | null>;
+
+/**
+ * Get the stored password for the service and account, or store and return
+ * a newly generated one if none exists. A generator function is only called
+ * when a read finds nothing stored.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ * @param generator The new password, or a function returning it (or a promise
+ *                  for it). A Buffer is stored and returned as a binary secret.
+ *
+ * @returns A promise for the stored password.
+ */
+export declare function getOrSetPassword(service: string, account: string, generator: string | (() => string | Promise<string>)): Promise<string>;
+export declare function getOrSetPassword(service: string, account: string, generator: Buffer): Promise<Buffer>;
+
+/**
+ * Like `getOrSetPassword`, for binary secrets produced by a generator
+ * function.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ * @param generator The new password Buffer, or a function returning it (or a
+ *                  promise for it).
+ *
+ * @returns A promise for the stored password Buffer.
+ */
+export declare function getOrSetPasswordBuffer(service: string, account: string, generator: Buffer | (() => Buffer | Promise<Buffer>)): Promise<Buffer>;
+
+/**
+ * Store a new password for the service and account and return the one it
+ * replaced.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ * @param password The new string or Buffer password.
+ *
+ * @returns A promise for the previous password, or null if there was none.
+ */
+export declare function replacePassword(service: string, account: string, password: string): Promise<string | null>;
+export declare function replacePassword(service: string, account: string, password: Buffer): Promise<Buffer | null>;
+
+/**
+ * Delete every account stored for `service` in the keychain.
+ *
+ * @param service The string service name.
+ *
+ * @returns A promise for the number of deleted entries.
+ */
+export declare function deleteCredentials(service: string): Promise<number>;
+
+/**
+ * Write an encrypted export of every account stored for `service` to
+ * `stream`. Entries are read and encrypted a batch at a time, and the
+ * stream's backpressure is respected. The stream is not ended. The names
+ * of all accounts are listed up front, so memory use grows with their
+ * number, but not with the size of the secrets.
+ *
+ * @param service The string service name.
+ * @param stream The writable stream receiving the export.
+ * @param key A 32-byte Buffer used to encrypt the export.
+ *
+ * @returns A promise for the number of exported entries.
+ */
+export declare function exportCredentials(service: string, stream: NodeJS.WritableStream, key: Buffer): Promise<number>;
+
+/**
+ * Read an export produced by `exportCredentials` from `stream` and store
+ * each entry as soon as it is decrypted. Rejects if the key is wrong or the
+ * export is corrupt or truncated; entries stored before that point are kept.
+ *
+ * @param stream The readable stream holding the export.
+ * @param key The 32-byte Buffer the export was encrypted with.
+ *
+ * @returns A promise for the number of imported entries.
+ */
+export declare function importCredentials(stream: NodeJS.ReadableStream, key: Buffer): Promise<number>;
 
 /**
  * Find all accounts and passwords for `service` in the keychain.
  *
  * @param service The string service name.
+ * @param options Optional collections to search concurrently. Entries found
+ *                this way name their collection in `settings.collection`.
+ *                `format: 'packed'` returns a PackedCredentials view instead
+ *                of an array.
  *
  * @returns A promise for the array of found credentials.
  */
-export declare function findCredentials(service: string): Promise<Array<{ account: string, password: string}>>;
+export declare function findCredentials(service: string, options: CollectionSearchOptions & { format: 'packed' }): Promise<PackedCredentials>;
+export declare function findCredentials(service: string, options?: CollectionSearchOptions & { format?: 'objects' }): Promise<Array<{ account: string, password: string, created?: number, modified?: number }>>;
+
+/**
+ * Credentials returned by `findCredentials` with `{ format: 'packed' }`.
+ * They are held in one buffer and decoded only when accessed.
+ */
+export interface PackedCredentials extends Iterable<{ server: string, account: string, settings: { [name: string]: string }, created?: number, modified?: number }> {
+  /** The number of entries. */
+  readonly length: number;
+  server(index: number): string;
+  account(index: number): string;
+  /** One setting of an entry, or undefined if it has none by that name. */
+  setting(index: number, name: string): string | undefined;
+  settings(index: number): { [name: string]: string };
+  /** The entry as `findCredentials` returns it by default. */
+  get(index: number): { server: string, account: string, settings: { [name: string]: string }, created?: number, modified?: number };
+  toArray(): Array<{ server: string, account: string, settings: { [name: string]: string }, created?: number, modified?: number }>;
+}
+
+/**
+ * Load every entry of each service into memory with one keychain search per
+ * service. Later `getPassword`, `getPasswordBuffer` and `findPassword`
+ * calls for these services are answered from memory until this process
+ * writes the entry or the service is preloaded again.
+ *
+ * @param services The string service names.
+ *
+ * @returns A promise for the number of loaded entries.
+ */
+export declare function preload(services: string[]): Promise<number>;
+
+/**
+ * Write the secret for the service and account into an anonymous in-memory
+ * file, for a child process to inherit through `child_process.spawn`'s
+ * `stdio` option. Linux only. The caller closes the descriptor once the
+ * child has been spawned.
+ *
+ * @param service The string service name.
+ * @param account The string account name.
+ *
+ * @returns A promise for the file descriptor, or null if there is no such
+ *          entry.
+ */
+export declare function exportToFd(service: string, account: string): Promise<number | null>;
+
+/**
+ * Read a secret written by `exportToFd` from an inherited descriptor, and
+ * close the descriptor.
+ *
+ * @param fd The file descriptor.
+ *
+ * @returns A promise for the secret.
+ */
+export declare function readFromFd(fd: number): Promise<string>;
+
+/**
+ * Like `readFromFd`, for secrets stored with `setPasswordBuffer`.
+ *
+ * @param fd The file descriptor.
+ *
+ * @returns A promise for the secret bytes.
+ */
+export declare function readBufferFromFd(fd: number): Promise<Buffer>;
+
+/**
+ * The result of `findCredentialsSince`.
+ */
+export interface CredentialChanges {
+  /** Entries modified at or after the requested time. */
+  credentials: Array<{ account: string, server: string, settings: { [name: string]: string }, created?: number, modified?: number }>;
+  /** The account of every entry that currently exists. */
+  accounts: string[];
+  /** The newest modification time seen, to pass to the next call. */
+  latest: number;
+}
+
+/**
+ * Find the accounts for `service` modified at or after `modifiedSince`,
+ * along with the names of all accounts that still exist.
+ *
+ * Every call enumerates all entries of `service`, so its cost grows with
+ * the size of the service rather than the number of changes.
+ *
+ * @param service The string service name.
+ * @param modifiedSince A Date or milliseconds since the Unix epoch.
+ *
+ * @returns A promise for the changes.
+ */
+export declare function findCredentialsSince(service: string, modifiedSince: Date | number): Promise<CredentialChanges>;
@@ -1,4 +1,9 @@
 var keytar = require('../build/Release/keytar.node')
+var PackedCredentials = require('./packed-credentials')
+var WriteCoalescer = require('./write-coalescer')
+
+var DEFAULT_COMPRESS_THRESHOLD = 1024
+var TRANSFER_KEY_SIZE = 32
 
 function checkRequired(val, name) {
   if (!val || val.length <= 0) {
@@ -6,6 +11,149 @@ function checkRequired(val, name) {
   }
 }
 
+function checkBuffer(val, name) {
+  if (!Buffer.isBuffer(val)) {
+    throw new Error(name + ' must be a Buffer.');
+  }
+}
+
+function checkFd(fd) {
+  if (!Number.isInteger(fd) || fd < 0) {
+    throw new Error('fd must be a file descriptor.')
+  }
+}
+
+function compressThreshold(options) {
+  if (typeof options.compressThreshold === 'number') {
+    // The native side takes an unsigned 32-bit size.
+    return Math.max(0, Math.min(options.compressThreshold, 0xffffffff))
+  }
+  return DEFAULT_COMPRESS_THRESHOLD
+}
+
+function checkKeyTimeout(timeout) {
+  if (typeof timeout !== 'number' || !(timeout >= 0 && timeout <= 0xffffffff)) {
+    throw new Error('keyTimeout must be a number of seconds.')
+  }
+}
+
+// Returns the key timeout for a single write in `options`, or undefined to
+// keep the one passed to `configure`.
+function keyTimeoutOf(options) {
+  if (!options || options.keyTimeout === undefined) {
+    return undefined
+  }
+  checkKeyTimeout(options.keyTimeout)
+  if (options.collection !== undefined || options.largeValue || isConditional(options)) {
+    throw new Error('keyTimeout cannot be combined with collection, largeValue or conditional writes.')
+  }
+  return Math.floor(options.keyTimeout)
+}
+
+// Returns the collection named by `options`, or null for the default one.
+function collectionOf(options) {
+  if (!options || options.collection === undefined) {
+    return null
+  }
+  checkRequired(options.collection, 'Collection')
+  if (options.largeValue || isConditional(options)) {
+    throw new Error('The collection option cannot be combined with largeValue or conditional writes.')
+  }
+  return options.collection
+}
+
+// Copies the "created" and "modified" settings onto each result as numbers
+// of milliseconds since the Unix epoch.
+function withTimestamps(credentials) {
+  credentials.forEach(function (cred) {
+    var settings = cred.settings || {}
+    if (settings.created !== undefined) cred.created = Number(settings.created)
+    if (settings.modified !== undefined) cred.modified = Number(settings.modified)
+  })
+  return credentials
+}
+
+function checkTransferKey(key) {
+  if (!Buffer.isBuffer(key) || key.length !== TRANSFER_KEY_SIZE) {
+    throw new Error('Key must be a ' + TRANSFER_KEY_SIZE + '-byte Buffer.')
+  }
+}
+
+// Writes `chunk` to `stream`, resolving once the stream can take more.
+function writeChunk(stream, chunk) {
+  return new Promise(function (resolve, reject) {
+    function onDrain() {
+      stream.removeListener('error', onError)
+      resolve()
+    }
+    function onError(err) {
+      stream.removeListener('drain', onDrain)
+      reject(err)
+    }
+    if (stream.write(chunk)) {
+      resolve()
+    } else {
+      stream.once('drain', onDrain)
+      stream.once('error', onError)
+    }
+  })
+}
+
+// Feeds `stream` to an import cursor one chunk at a time, pausing the stream
+// while each chunk is decrypted and stored.
+function readChunks(stream, cursor) {
+  return new Promise(function (resolve, reject) {
+    var failed = false
+    function cleanup() {
+      stream.removeListener('data', onData)
+      stream.removeListener('end', onEnd)
+      stream.removeListener('error', onError)
+    }
+    function onError(err) {
+      if (!failed) {
+        failed = true
+        cleanup()
+        reject(err)
+      }
+    }
+    function onData(chunk) {
+      stream.pause()
+      var data = Buffer.isBuffer(chunk) ? chunk : Buffer.from(chunk)
+      callbackPromise(callback => cursor.write(data, callback)).then(function () {
+        if (!failed) {
+          stream.resume()
+        }
+      }, onError)
+    }
+    function onEnd() {
+      cleanup()
+      try {
+        resolve(cursor.finish())
+      } catch (err) {
+        reject(err)
+      }
+    }
+    stream.on('data', onData)
+    stream.on('end', onEnd)
+    stream.on('error', onError)
+    stream.resume()
+  })
+}
+
+function isConditional(options) {
+  if (!options) {
+    return false
+  }
+  var conditional = options.ifChanged || options.expected !== undefined
+  if (conditional && options.largeValue) {
+    throw new Error('Conditional writes are not supported in large-value mode.')
+  }
+  if (options.ifChanged && options.expected !== undefined) {
+    throw new Error('ifChanged and expected cannot be combined.')
+  }
+  return conditional
+}
+
 function callbackPromise(callback) {
   if (typeof callback === 'function') {
     return new Promise(function(resolve, reject) {
@@ -22,37 +170,336 @@ function callbackPromise(callback) {
   }
 }
 
+var coalescer = new WriteCoalescer(function (service, account, password, binary) {
+  if (binary) {
+    return callbackPromise(callback => keytar.setPasswordBuffer(service, account, password, callback))
+  }
+  return callbackPromise(callback => keytar.setPassword(service, account, password, callback))
+})
+
+// Runs `run` once coalesced writes that could affect its result are done.
+function afterWrites(service, account, run) {
+  var settled = coalescer.settle(service, account)
+  return settled ? settled.then(run) : run()
+}
+
+// Runs the generator of getOrSetPassword only when a read finds nothing, so
+// an expensive one isn't paid for on every call. The native getOrSet still
+// decides, in case another process stores a value in between.
+function getOrSet(service, account, generator, binary) {
+  var read = binary ? keytar.getPasswordBuffer : keytar.getPassword
+  return afterWrites(service, account, function () {
+    return callbackPromise(callback => read(service, account, callback)).then(function (stored) {
+      if (stored !== null) {
+        return stored
+      }
+      return Promise.resolve(generator()).then(password => {
+        checkRequired(password, 'Password')
+        if (binary) {
+          checkBuffer(password, 'Password')
+        }
+        return callbackPromise(callback => keytar.getOrSetPassword(service, account, password, Buffer.isBuffer(password), callback))
+      })
+    })
+  })
+}
+
+// Wraps a native CredentialHandle, whose service and account were checked
+// and converted once, with the promise API of the plain calls.
+function credentialHandle(service, account) {
+  var native = new keytar.CredentialHandle(service, account)
+  function write(password, binary) {
+    if (coalescer.enabled()) {
+      return coalescer.write(service, account, password, binary)
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => native.set(password, callback)))
+  }
+  return {
+    service: service,
+    account: account,
+    get: function () {
+      return afterWrites(service, account, () => callbackPromise(callback => native.get(false, callback)))
+    },
+    getBuffer: function () {
+      return afterWrites(service, account, () => callbackPromise(callback => native.get(true, callback)))
+    },
+    set: function (password) {
+      checkRequired(password, 'Password')
+      return write(password, false)
+    },
+    setBuffer: function (password) {
+      checkRequired(password, 'Password')
+      checkBuffer(password, 'Password')
+      return write(password, true)
+    },
+    delete: function () {
+      return afterWrites(service, account, () => callbackPromise(callback => native.delete(callback)))
+    }
+  }
+}
+
 module.exports = {
-  getPassword: function (service, account) {
+  configure: function (options) {
+    if (options.backend !== undefined) {
+      var timeout = options.keyTimeout === undefined ? 0 : options.keyTimeout
+      checkKeyTimeout(timeout)
+      keytar.configureBackend(options.backend, options.keyring || '', Math.floor(timeout))
+    }
+    if (options.writeCoalescingWindow !== undefined) {
+      coalescer.setWindow(options.writeCoalescingWindow)
+    }
+    if (options.idleTimeout !== undefined) {
+      if (typeof options.idleTimeout !== 'number' || !(options.idleTimeout >= 0 && options.idleTimeout <= 0xffffffff)) {
+        throw new Error('idleTimeout must be a number of milliseconds.')
+      }
+      keytar.setIdleTimeout(Math.floor(options.idleTimeout))
+    }
+    if (options.interactive !== undefined) {
+      keytar.setInteractive(!!options.interactive)
+    }
+  },
+
+  unlock: function (collections) {
+    collections = collections === undefined ? [] : collections
+    if (!Array.isArray(collections)) {
+      throw new Error('collections must be an array.')
+    }
+    collections.forEach(collection => checkRequired(collection, 'Collection'))
+
+    return callbackPromise(callback => keytar.unlock(collections, callback))
+  },
+
+  release: function () {
+    return callbackPromise(callback => keytar.release(callback))
+  },
+
+  getPassword: function (service, account, options) {
     checkRequired(service, 'Service')
     checkRequired(account, 'Account')
 
-    return callbackPromise(callback => keytar.getPassword(service, account, callback))
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.getPasswordInCollection(collection, service, account, false, callback)))
+    }
+    if (options && options.largeValue) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.getLargePassword(service, account, false, callback)))
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.getPassword(service, account, callback)))
   },
 
-  setPassword: function (service, account, password) {
+  setPassword: function (service, account, password, options) {
     checkRequired(service, 'Service')
     checkRequired(account, 'Account')
     checkRequired(password, 'Password')
 
-    return callbackPromise(callback => keytar.setPassword(service, account, password, callback))
+    var timeout = keyTimeoutOf(options)
+    if (timeout !== undefined) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordWithTimeout(service, account, password, false, timeout, callback)))
+    }
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordInCollection(collection, service, account, password, false, callback)))
+    }
+    if (isConditional(options)) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordConditional(service, account, password, false, !!options.ifChanged, options.expected, callback)))
+    }
+    if (options && options.largeValue) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setLargePassword(service, account, password, compressThreshold(options), callback)))
+    }
+    if (coalescer.enabled()) {
+      return coalescer.write(service, account, password, false)
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.setPassword(service, account, password, callback)))
   },
 
-  deletePassword: function (service, account) {
+  getPasswordBuffer: function (service, account, options) {
     checkRequired(service, 'Service')
     checkRequired(account, 'Account')
 
-    return callbackPromise(callback => keytar.deletePassword(service, account, callback))
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.getPasswordInCollection(collection, service, account, true, callback)))
+    }
+    if (options && options.largeValue) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.getLargePassword(service, account, true, callback)))
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.getPasswordBuffer(service, account, callback)))
   },
 
-  findPassword: function (service) {
+  setPasswordBuffer: function (service, account, password, options) {
     checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+    checkRequired(password, 'Password')
+    checkBuffer(password, 'Password')
 
-    return callbackPromise(callback => keytar.findPassword(service, callback))
+    var timeout = keyTimeoutOf(options)
+    if (timeout !== undefined) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordWithTimeout(service, account, password, true, timeout, callback)))
+    }
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordInCollection(collection, service, account, password, true, callback)))
+    }
+    if (isConditional(options)) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordConditional(service, account, password, true, !!options.ifChanged, options.expected, callback)))
+    }
+    if (options && options.largeValue) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.setLargePassword(service, account, password, compressThreshold(options), callback)))
+    }
+    if (coalescer.enabled()) {
+      return coalescer.write(service, account, password, true)
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.setPasswordBuffer(service, account, password, callback)))
   },
 
-  findCredentials: function (service) {
+  deletePassword: function (service, account, options) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.deletePasswordInCollection(collection, service, account, callback)))
+    }
+    if (options && options.largeValue) {
+      return afterWrites(service, account, () => callbackPromise(callback => keytar.deleteLargePassword(service, account, callback)))
+    }
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.deletePassword(service, account, callback)))
+  },
+
+  handle: function (service, account) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+
+    return credentialHandle(service, account)
+  },
+
+  findPassword: function (service, options) {
+    checkRequired(service, 'Service')
+
+    var collection = collectionOf(options)
+    if (collection) {
+      return afterWrites(service, undefined, () => callbackPromise(callback => keytar.findPasswordInCollection(collection, service, callback)))
+    }
+    return afterWrites(service, undefined, () => callbackPromise(callback => keytar.findPassword(service, callback)))
+  },
+
+  getOrSetPassword: function (service, account, generator) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+
+    if (typeof generator === 'function') {
+      return getOrSet(service, account, generator, false)
+    }
+    checkRequired(generator, 'Password')
+    var binary = Buffer.isBuffer(generator)
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.getOrSetPassword(service, account, generator, binary, callback)))
+  },
+
+  getOrSetPasswordBuffer: function (service, account, generator) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+
+    if (typeof generator === 'function') {
+      return getOrSet(service, account, generator, true)
+    }
+    checkRequired(generator, 'Password')
+    checkBuffer(generator, 'Password')
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.getOrSetPassword(service, account, generator, true, callback)))
+  },
+
+  replacePassword: function (service, account, password) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+    checkRequired(password, 'Password')
+
+    var binary = Buffer.isBuffer(password)
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.replacePassword(service, account, password, binary, callback)))
+  },
+
+  deleteCredentials: function (service) {
+    checkRequired(service, 'Service')
+
+    return afterWrites(service, undefined, () => callbackPromise(callback => keytar.deleteCredentials(service, callback)))
+  },
+
+  exportCredentials: function (service, stream, key) {
+    checkRequired(service, 'Service')
+    checkTransferKey(key)
+
+    var cursor = new keytar.ExportCursor(service, key)
+    function pump() {
+      return callbackPromise(callback => cursor.next(callback)).then(function (chunk) {
+        return chunk === null ? cursor.count() : writeChunk(stream, chunk).then(pump)
+      })
+    }
+    return afterWrites(service, undefined, pump)
+  },
 
-    return callbackPromise(callback => keytar.findCredentials(service, callback))
+  importCredentials: function (stream, key) {
+    checkTransferKey(key)
+
+    var cursor = new keytar.ImportCursor(key)
+    return afterWrites(undefined, undefined, () => readChunks(stream, cursor))
+  },
+
+  preload: function (services) {
+    if (!Array.isArray(services) || services.length === 0) {
+      throw new Error('services must be a non-empty array.')
+    }
+    services.forEach(service => checkRequired(service, 'Service'))
+
+    return afterWrites(undefined, undefined, () => callbackPromise(callback => keytar.preload(services, callback)))
+  },
+
+  exportToFd: function (service, account) {
+    checkRequired(service, 'Service')
+    checkRequired(account, 'Account')
+
+    return afterWrites(service, account, () => callbackPromise(callback => keytar.exportToFd(service, account, callback)))
+  },
+
+  readFromFd: function (fd) {
+    checkFd(fd)
+    return new Promise(resolve => resolve(keytar.readFromFd(fd, false)))
+  },
+
+  readBufferFromFd: function (fd) {
+    checkFd(fd)
+    return new Promise(resolve => resolve(keytar.readFromFd(fd, true)))
+  },
+
+  findCredentials: function (service, options) {
+    var format = options && options.format
+    if (format !== undefined && format !== 'objects' && format !== 'packed') {
+      throw new Error("format must be 'objects' or 'packed'.")
+    }
+    var packed = format === 'packed'
+    var found = packed ? (buffer => new PackedCredentials(buffer)) : withTimestamps
+
+    var collections = options && options.collections
+    if (!collections && collectionOf(options)) {
+      collections = [options.collection]
+    }
+    if (collections) {
+      if (!Array.isArray(collections) || collections.length === 0) {
+        throw new Error('collections must be a non-empty array.')
+      }
+      collections.forEach(collection => checkRequired(collection, 'Collection'))
+      return afterWrites(service, undefined, () => callbackPromise(callback => keytar.findCredentialsInCollections(collections, service, packed, callback))).then(found)
+    }
+    return afterWrites(service, undefined, () => callbackPromise(callback => keytar.findCredentials(service, packed, callback))).then(found)
+  },
+
+  findCredentialsSince: function (service, modifiedSince) {
+    checkRequired(service, 'Service')
+    var since = modifiedSince instanceof Date ? modifiedSince.getTime() : modifiedSince
+    if (typeof since !== 'number' || isNaN(since)) {
+      throw new Error('modifiedSince must be a Date or a number of milliseconds.')
+    }
+
+    return afterWrites(service, undefined, () => callbackPromise(callback => keytar.findCredentialsSince(service, Math.floor(since), callback))).then(function (result) {
+      withTimestamps(result.credentials)
+      return result
+    })
   }
 }
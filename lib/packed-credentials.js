@@ -0,0 +1,106 @@
+// Read-only view of credentials packed by src/packed_credentials.cc.
+//
+// Entries are decoded on access, so code that only looks at a few fields of
+// a large enumeration never creates an object per entry. See
+// packed_credentials.h for the layout.
+
+var HEADER_SIZE = 16
+var ENTRY_SIZE = 24
+var SETTING_SIZE = 16
+var VERSION = 1
+
+function PackedCredentials(buffer) {
+  if (buffer.readUInt32LE(0) !== VERSION) {
+    throw new Error('Unsupported packed credentials version.')
+  }
+  this.buffer = buffer
+  this.length = buffer.readUInt32LE(4)
+  this.settingsOffset = HEADER_SIZE + this.length * ENTRY_SIZE
+  this.poolOffset = buffer.readUInt32LE(12)
+}
+
+PackedCredentials.prototype.string = function (offset, length) {
+  var start = this.poolOffset + offset
+  return this.buffer.toString('utf8', start, start + length)
+}
+
+PackedCredentials.prototype.word = function (index, field) {
+  this.checkIndex(index)
+  return this.buffer.readUInt32LE(HEADER_SIZE + index * ENTRY_SIZE + field * 4)
+}
+
+PackedCredentials.prototype.checkIndex = function (index) {
+  if (!(index >= 0 && index < this.length)) {
+    throw new RangeError('Index out of range: ' + index)
+  }
+}
+
+PackedCredentials.prototype.server = function (index) {
+  return this.string(this.word(index, 0), this.word(index, 1))
+}
+
+PackedCredentials.prototype.account = function (index) {
+  return this.string(this.word(index, 2), this.word(index, 3))
+}
+
+// Returns the value of one setting of the entry, or undefined.
+PackedCredentials.prototype.setting = function (index, name) {
+  var first = this.word(index, 4)
+  var count = this.word(index, 5)
+  for (var i = first; i < first + count; i++) {
+    var offset = this.settingsOffset + i * SETTING_SIZE
+    if (this.string(this.buffer.readUInt32LE(offset), this.buffer.readUInt32LE(offset + 4)) === name) {
+      return this.string(this.buffer.readUInt32LE(offset + 8), this.buffer.readUInt32LE(offset + 12))
+    }
+  }
+  return undefined
+}
+
+PackedCredentials.prototype.settings = function (index) {
+  var first = this.word(index, 4)
+  var count = this.word(index, 5)
+  var settings = {}
+  for (var i = first; i < first + count; i++) {
+    var offset = this.settingsOffset + i * SETTING_SIZE
+    var name = this.string(this.buffer.readUInt32LE(offset), this.buffer.readUInt32LE(offset + 4))
+    settings[name] = this.string(this.buffer.readUInt32LE(offset + 8), this.buffer.readUInt32LE(offset + 12))
+  }
+  return settings
+}
+
+// Builds the object findCredentials would have returned for the entry.
+PackedCredentials.prototype.get = function (index) {
+  var cred = {
+    server: this.server(index),
+    account: this.account(index),
+    settings: this.settings(index)
+  }
+  if (cred.settings.created !== undefined) cred.created = Number(cred.settings.created)
+  if (cred.settings.modified !== undefined) cred.modified = Number(cred.settings.modified)
+  return cred
+}
+
+PackedCredentials.prototype.toArray = function () {
+  var result = []
+  for (var i = 0; i < this.length; i++) {
+    result.push(this.get(i))
+  }
+  return result
+}
+
+if (typeof Symbol === 'function' && Symbol.iterator) {
+  PackedCredentials.prototype[Symbol.iterator] = function () {
+    var view = this
+    var index = 0
+    return {
+      next: function () {
+        if (index >= view.length) {
+          return {done: true, value: undefined}
+        }
+        return {done: false, value: view.get(index++)}
+      }
+    }
+  }
+}
+
+module.exports = PackedCredentials
@@ -0,0 +1,101 @@
+// Write-behind queue that collapses rapid successive writes to the same
+// (service, account) into a single native write.
+//
+// The first write to a key starts a timer of `window` milliseconds; writes
+// arriving before it fires replace the queued value, and every caller's
+// promise settles with the outcome of the one write that is finally issued.
+// Writes to a key are issued strictly in order, and `settle` lets reads,
+// deletes and other writes wait for queued and running writes first, so
+// they never observe a value older than one already written.
+
+function WriteCoalescer(issue) {
+  this.issue = issue
+  this.window = 0
+  this.pending = {}
+  this.running = {}
+}
+
+function keyFor(service, account) {
+  return JSON.stringify([service, account])
+}
+
+WriteCoalescer.prototype.enabled = function () {
+  return this.window > 0
+}
+
+WriteCoalescer.prototype.setWindow = function (window) {
+  this.window = window > 0 ? window : 0
+  if (!this.enabled()) {
+    Object.keys(this.pending).forEach(this.flush, this)
+  }
+}
+
+WriteCoalescer.prototype.write = function (service, account, password, binary) {
+  var key = keyFor(service, account)
+  var entry = this.pending[key]
+  if (!entry) {
+    entry = {service: service, account: account, waiters: []}
+    entry.timer = setTimeout(this.flush.bind(this, key), this.window)
+    this.pending[key] = entry
+  }
+  entry.password = password
+  entry.binary = binary
+
+  return new Promise(function (resolve, reject) {
+    entry.waiters.push({resolve: resolve, reject: reject})
+  })
+}
+
+WriteCoalescer.prototype.flush = function (key) {
+  var entry = this.pending[key]
+  if (!entry) {
+    return this.running[key]
+  }
+  delete this.pending[key]
+  clearTimeout(entry.timer)
+
+  var self = this
+  var issue = this.issue
+  var previous = this.running[key] || Promise.resolve()
+  var done = previous.then(function () {
+    return issue(entry.service, entry.account, entry.password, entry.binary)
+  }).then(function () {
+    entry.waiters.forEach(function (waiter) { waiter.resolve() })
+  }, function (err) {
+    entry.waiters.forEach(function (waiter) { waiter.reject(err) })
+  })
+
+  this.running[key] = done
+  done.then(function () {
+    if (self.running[key] === done) {
+      delete self.running[key]
+    }
+  })
+  return done
+}
+
+// Returns a promise that resolves once every queued or running write to
+// (service, account) has completed, or to any account of `service` when
+// `account` is undefined. Returns null when there is nothing to wait for.
+WriteCoalescer.prototype.settle = function (service, account) {
+  var keys = Object.keys(this.pending)
+  Object.keys(this.running).forEach(function (key) {
+    if (!this.pending[key]) {
+      keys.push(key)
+    }
+  }, this)
+  if (keys.length === 0) {
+    return null
+  }
+
+  var waits = []
+  keys.forEach(function (key) {
+    var parts = JSON.parse(key)
+    if (!service || (parts[0] === service && (account === undefined || parts[1] === account))) {
+      waits.push(this.flush(key))
+    }
+  }, this)
+  return waits.length > 0 ? Promise.all(waits) : null
+}
+
+module.exports = WriteCoalescer
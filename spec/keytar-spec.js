@@ -1,4 +1,8 @@
 var assert = require('chai').assert
+var childProcess = require('child_process')
+var fs = require('fs')
+var os = require('os')
+var path = require('path')
 var keytar = require('../')
 
 describe("keytar", function() {
@@ -34,6 +38,20 @@ describe("keytar", function() {
       assert.equal(await keytar.getPassword(service, account), null)
     })
 
+    it("yields entries that another process deleted and recreated", async function() {
+      await keytar.setPassword(service, account, password)
+      assert.equal(await keytar.getPassword(service, account), password)
+
+      const script = 'const keytar = require(' + JSON.stringify(path.join(__dirname, '..')) + ');' +
+        'keytar.deletePassword(' + JSON.stringify(service) + ', ' + JSON.stringify(account) + ')' +
+        '.then(() => keytar.setPassword(' + JSON.stringify(service) + ', ' + JSON.stringify(account) + ', ' + JSON.stringify(password2) + '))'
+      childProcess.execFileSync(process.execPath, ['-e', script])
+
+      assert.equal(await keytar.getPassword(service, account), password2)
+      assert.equal(await keytar.deletePassword(service, account), true)
+      assert.equal(await keytar.getPassword(service, account), null)
+    })
+
     describe("Unicode support", function() {
       const service = "se®vi\u00C7e"
       const account = "shi\u0191\u2020ke\u00A5"
@@ -50,6 +68,263 @@ describe("keytar", function() {
     })
   })
 
+  describe("setPasswordBuffer/getPasswordBuffer(service, account)", function() {
+    it("round-trips arbitrary bytes", async function() {
+      const bytes = Buffer.from([0x00, 0xff, 0x80, 0x0a, 0x00, 0xc3, 0x28])
+      await keytar.setPasswordBuffer(service, account, bytes)
+      const found = await keytar.getPasswordBuffer(service, account)
+      assert.isTrue(Buffer.isBuffer(found))
+      assert.isTrue(bytes.equals(found))
+    })
+
+    it("yields null when the password was not found", async function() {
+      assert.equal(await keytar.getPasswordBuffer(service, account), null)
+    })
+
+    it("rejects non-Buffer passwords", function() {
+      assert.throws(() => keytar.setPasswordBuffer(service, account, 'secret'), /must be a Buffer/)
+    })
+  })
+
+  describe("write coalescing", function() {
+    beforeEach(function() {
+      keytar.configure({writeCoalescingWindow: 50})
+    })
+
+    afterEach(function() {
+      keytar.configure({writeCoalescingWindow: 0})
+    })
+
+    it("resolves every collapsed write and stores the last value", async function() {
+      const writes = [password, 'middle', password2].map(value =>
+        keytar.setPassword(service, account, value))
+      await Promise.all(writes)
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("never serves a stale value to a read issued after a write", async function() {
+      await keytar.setPassword(service, account, password)
+      keytar.setPassword(service, account, password2)
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("collapses Buffer writes", async function() {
+      await Promise.all([Buffer.from(password), Buffer.from(password2)].map(value =>
+        keytar.setPasswordBuffer(service, account, value)))
+      assert.equal((await keytar.getPasswordBuffer(service, account)).toString(), password2)
+    })
+
+    it("applies a delete after queued writes", async function() {
+      keytar.setPassword(service, account, password)
+      assert.equal(await keytar.deletePassword(service, account), true)
+      assert.equal(await keytar.getPassword(service, account), null)
+    })
+  })
+
+  describe("conditional writes", function() {
+    it("skips unchanged values with ifChanged", async function() {
+      assert.equal(await keytar.setPassword(service, account, password, {ifChanged: true}), true)
+      assert.equal(await keytar.setPassword(service, account, password, {ifChanged: true}), false)
+      assert.equal(await keytar.setPassword(service, account, password2, {ifChanged: true}), true)
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("only writes when the expected value matches", async function() {
+      assert.equal(await keytar.setPassword(service, account, password, {expected: null}), true)
+      assert.equal(await keytar.setPassword(service, account, password2, {expected: null}), false)
+      assert.equal(await keytar.setPassword(service, account, password2, {expected: 'stale'}), false)
+      assert.equal(await keytar.getPassword(service, account), password)
+      assert.equal(await keytar.setPassword(service, account, password2, {expected: password}), true)
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("lets exactly one of several concurrent writers win", async function() {
+      await keytar.setPassword(service, account, password)
+      const results = await Promise.all(['a', 'b', 'c', 'd'].map(value =>
+        keytar.setPassword(service, account, value, {expected: password})))
+      assert.equal(results.filter(Boolean).length, 1)
+    })
+  })
+
+  describe("compound operations", function() {
+    it("stores a generated password only when none exists", async function() {
+      assert.equal(await keytar.getOrSetPassword(service, account, () => password), password)
+      assert.equal(await keytar.getOrSetPassword(service, account, () => password2), password)
+      assert.equal(await keytar.getPassword(service, account), password)
+    })
+
+    it("only calls the generator when nothing is stored", async function() {
+      let calls = 0
+      const generator = () => { calls++; return Buffer.from(password) }
+      assert.isTrue((await keytar.getOrSetPasswordBuffer(service, account, generator)).equals(Buffer.from(password)))
+      assert.isTrue((await keytar.getOrSetPasswordBuffer(service, account, generator)).equals(Buffer.from(password)))
+      assert.equal(calls, 1)
+    })
+
+    it("returns the replaced password", async function() {
+      assert.equal(await keytar.replacePassword(service, account, password), null)
+      assert.equal(await keytar.replacePassword(service, account, password2), password)
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("deletes every account of a service", async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.setPassword(service, account2, password2)
+      assert.equal(await keytar.deleteCredentials(service), 2)
+      assert.deepEqual(await keytar.findCredentials(service), [])
+      assert.equal(await keytar.deleteCredentials(service), 0)
+    })
+  })
+
+  describe("collections", function() {
+    const options = {collection: 'session'}
+
+    before(function() {
+      if (process.platform !== 'linux') {
+        this.skip()
+      }
+    })
+
+    afterEach(async function() {
+      await keytar.deletePassword(service, account, options)
+    })
+
+    it("keeps entries in the given collection", async function() {
+      await keytar.setPassword(service, account, password, options)
+      assert.equal(await keytar.getPassword(service, account, options), password)
+      assert.equal(await keytar.findPassword(service, options), password)
+      assert.equal(await keytar.deletePassword(service, account, options), true)
+      assert.equal(await keytar.getPassword(service, account, options), null)
+    })
+
+    it("searches several collections at once", async function() {
+      await keytar.setPassword(service, account, password, options)
+      await keytar.setPassword(service, account2, password2)
+
+      const found = await keytar.findCredentials(service, {collections: ['session', 'default']})
+      assert.deepEqual(found.map(cred => [cred.account, cred.settings.collection]).sort(),
+                       [[account, 'session'], [account2, 'default']])
+    })
+
+    it("deletes copies in every collection", async function() {
+      await keytar.setPassword(service, account, password, options)
+      await keytar.setPassword(service, account, password2)
+      // Remembers the path of the default collection's item.
+      assert.equal(await keytar.getPassword(service, account), password2)
+
+      assert.equal(await keytar.deletePassword(service, account), true)
+      assert.equal(await keytar.getPassword(service, account), null)
+      assert.equal(await keytar.getPassword(service, account, options), null)
+    })
+
+    it("fails for unknown collections", async function() {
+      let error = null
+      await keytar.getPassword(service, account, {collection: 'no such collection'}).catch(err => error = err)
+      assert.match(error.message, /no such collection/)
+    })
+  })
+
+  describe("exportCredentials/importCredentials", function() {
+    const stream = require('stream')
+    const key = Buffer.alloc(32, 7)
+
+    async function exportToBuffer(service, key) {
+      const chunks = []
+      const sink = new stream.Writable({
+        write(chunk, encoding, callback) {
+          chunks.push(chunk)
+          callback()
+        }
+      })
+      const count = await keytar.exportCredentials(service, sink, key)
+      return {count: count, data: Buffer.concat(chunks)}
+    }
+
+    function streamOf(data) {
+      const source = new stream.PassThrough()
+      source.end(data)
+      return source
+    }
+
+    it("restores every exported entry", async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.setPasswordBuffer(service, account2, Buffer.from([0, 1, 2, 255]))
+      const exported = await exportToBuffer(service, key)
+      assert.equal(exported.count, 2)
+      assert.equal(await keytar.deleteCredentials(service), 2)
+
+      assert.equal(await keytar.importCredentials(streamOf(exported.data), key), 2)
+      assert.equal(await keytar.getPassword(service, account), password)
+      assert.deepEqual(await keytar.getPasswordBuffer(service, account2), Buffer.from([0, 1, 2, 255]))
+    })
+
+    it("rejects a wrong key and truncated exports", async function() {
+      await keytar.setPassword(service, account, password)
+      const exported = await exportToBuffer(service, key)
+
+      let error = null
+      await keytar.importCredentials(streamOf(exported.data), Buffer.alloc(32, 8)).catch(err => error = err)
+      assert.match(error.message, /authentication/)
+
+      error = null
+      await keytar.importCredentials(streamOf(exported.data.slice(0, -1)), key).catch(err => error = err)
+      assert.match(error.message, /truncated/)
+    })
+  })
+
+  describe("large-value mode", function() {
+    const options = {largeValue: true}
+
+    afterEach(async function() {
+      await keytar.deletePassword(service, account, options)
+    })
+
+    it("round-trips values that need compression and chunking", async function() {
+      const large = Buffer.alloc(4 * 1024 * 1024)
+      for (let i = 0; i < large.length; i++) {
+        large[i] = (i * 7919) & 0xff
+      }
+      await keytar.setPasswordBuffer(service, account, large, options)
+      assert.isTrue(large.equals(await keytar.getPasswordBuffer(service, account, options)))
+    })
+
+    it("round-trips small strings", async function() {
+      await keytar.setPassword(service, account, password, options)
+      assert.equal(await keytar.getPassword(service, account, options), password)
+    })
+
+    it("reads values stored without large-value mode", async function() {
+      await keytar.setPassword(service, account, password)
+      assert.equal(await keytar.getPassword(service, account, options), password)
+    })
+
+    it("removes every chunk on delete", async function() {
+      await keytar.setPassword(service, account, 'x'.repeat(3 * 1024 * 1024), {largeValue: true, compressThreshold: Infinity})
+      assert.equal(await keytar.deletePassword(service, account, options), true)
+      assert.deepEqual(await keytar.findCredentials('.keytar-chunks/' + service), [])
+      assert.equal(await keytar.getPassword(service, account, options), null)
+    })
+
+    it("keeps chunks out of the service's credentials on Windows", async function() {
+      if (process.platform !== 'win32') {
+        this.skip()
+      }
+      const large = Buffer.alloc(64 * 1024)
+      for (let i = 0; i < large.length; i++) {
+        large[i] = (i * 7919) & 0xff
+      }
+      await keytar.setPasswordBuffer(service, account, large, options)
+      const credentials = await keytar.findCredentials(service)
+      assert.deepEqual(credentials.map(credential => credential.account), [account])
+    })
+
+    it("reads plain values that start with the manifest magic", async function() {
+      const value = 'KTLV\u0002' + 'a'.repeat(40)
+      await keytar.setPassword(service, account, value)
+      assert.equal(await keytar.getPassword(service, account, options), value)
+    })
+  })
+
   describe("deletePassword(service, account)", function() {
     it("yields true when the password was deleted", async function() {
       await keytar.setPassword(service, account, password)
@@ -61,6 +336,25 @@ describe("keytar", function() {
     })
   })
 
+  describe("handle(service, account)", function() {
+    it("reads, writes and deletes the entry", async function() {
+      var handle = keytar.handle(service, account)
+      assert.equal(await handle.get(), null)
+      await handle.set(password)
+      assert.equal(await handle.get(), password)
+      assert.equal(await keytar.getPassword(service, account), password)
+      await handle.setBuffer(Buffer.from([0, 1, 2]))
+      assert.deepEqual(await handle.getBuffer(), Buffer.from([0, 1, 2]))
+      assert.equal(await handle.delete(), true)
+      assert.equal(await handle.delete(), false)
+    })
+
+    it("requires a service and account", function() {
+      assert.throws(() => keytar.handle('', account), /Service is required/)
+      assert.throws(() => keytar.handle(service, ''), /Account is required/)
+    })
+  })
+
   describe("findPassword(service)", function() {
     it("yields a password for the service", async function() {
       await keytar.setPassword(service, account, password),
@@ -87,6 +381,19 @@ describe("keytar", function() {
       assert.deepEqual([{account: account, password: password}, {account: account2, password: password2}], sorted)
     });
 
+    it('yields a packed view of the same entries', async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.setPassword(service, account2, password2)
+
+      const objects = await keytar.findCredentials(service)
+      const packed = await keytar.findCredentials(service, {format: 'packed'})
+      assert.equal(packed.length, objects.length)
+      const sorted = packed.toArray().sort((a, b) => a.account.localeCompare(b.account))
+      assert.deepEqual(sorted, objects.sort((a, b) => a.account.localeCompare(b.account)))
+      assert.equal(packed.server(0), service)
+      assert.sameMembers([packed.account(0), packed.account(1)], [account, account2])
+    })
+
     it('returns an empty array when no credentials are found', async function() {
       const accounts = await keytar.findCredentials(service)
       assert.deepEqual([], accounts)
@@ -114,4 +421,344 @@ describe("keytar", function() {
       })
     })
   });
+
+  describe("preload(services)", function() {
+    // A service of its own, so no other test reads through the cache.
+    const service = 'keytar preload tests'
+
+    function setFromOtherProcess(value) {
+      const script = 'const keytar = require(' + JSON.stringify(path.join(__dirname, '..')) + ');' +
+        'keytar.setPassword(' + JSON.stringify(service) + ', ' + JSON.stringify(account) + ', ' + JSON.stringify(value) + ')'
+      childProcess.execFileSync(process.execPath, ['-e', script])
+    }
+
+    afterEach(async function() {
+      await keytar.deleteCredentials(service)
+    })
+
+    it("serves reads from memory until the service is preloaded again", async function() {
+      await keytar.setPassword(service, account, password)
+      assert.equal(await keytar.preload([service]), 1)
+
+      setFromOtherProcess(password2)
+      assert.equal(await keytar.getPassword(service, account), password)
+      assert.equal(await keytar.findPassword(service), password)
+      assert.equal(await keytar.getPassword(service, account2), null)
+
+      await keytar.preload([service])
+      assert.equal(await keytar.getPassword(service, account), password2)
+    })
+
+    it("stops serving an entry once it is written locally", async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.preload([service])
+
+      await keytar.setPassword(service, account, password2)
+      assert.equal(await keytar.getPassword(service, account), password2)
+      await keytar.deletePassword(service, account)
+      assert.equal(await keytar.getPassword(service, account), null)
+    })
+  })
+
+  describe("interactive: false", function() {
+    afterEach(function() {
+      keytar.configure({interactive: true})
+    })
+
+    it("serves calls on an unlocked keyring without prompting", async function() {
+      await keytar.setPassword(service, account, password)
+      keytar.configure({interactive: false})
+      assert.isTrue(await keytar.unlock())
+      assert.equal(await keytar.getPassword(service, account), password)
+      assert.equal(await keytar.findPassword(service), password)
+      assert.lengthOf(await keytar.findCredentials(service), 1)
+    })
+  })
+
+  describe("release()", function() {
+    afterEach(function() {
+      keytar.configure({idleTimeout: 0})
+    })
+
+    it("reconnects on the next call", async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.release()
+      assert.equal(await keytar.getPassword(service, account), password)
+    })
+
+    it("reconnects after an idle timeout closed the connection", async function() {
+      keytar.configure({idleTimeout: 50})
+      await keytar.setPassword(service, account, password)
+      await new Promise(resolve => setTimeout(resolve, 200))
+      assert.equal(await keytar.getPassword(service, account), password)
+    })
+  })
+
+  describe("exportToFd(service, account)", function() {
+    before(function() {
+      if (process.platform !== 'linux') {
+        this.skip()
+      }
+    })
+
+    it("hands the secret to a child process through an inherited descriptor", async function() {
+      await keytar.setPassword(service, account, password)
+      const fd = await keytar.exportToFd(service, account)
+
+      const script = 'require(' + JSON.stringify(path.join(__dirname, '..')) + ').readFromFd(3)' +
+        '.then(secret => process.stdout.write(secret))'
+      let output
+      try {
+        output = childProcess.execFileSync(process.execPath, ['-e', script], {stdio: ['ignore', 'pipe', 'inherit', fd]})
+      } finally {
+        fs.closeSync(fd)
+      }
+      assert.equal(output.toString(), password)
+    })
+
+    it("yields null when the entry doesn't exist", async function() {
+      assert.equal(await keytar.exportToFd(service, account), null)
+    })
+  })
+
+  describe("findCredentialsSince(service, modifiedSince)", function() {
+    it("yields only entries modified since the given time", async function() {
+      this.timeout(10000)
+      await keytar.setPassword(service, account, password)
+      const first = await keytar.findCredentialsSince(service, 0)
+      assert.deepEqual(first.credentials.map(c => c.account), [account])
+      assert.isAbove(first.credentials[0].modified, 0)
+
+      // Backends record times to the second at best.
+      await new Promise(resolve => setTimeout(resolve, 1100))
+      await keytar.setPassword(service, account2, password2)
+      const second = await keytar.findCredentialsSince(service, first.latest + 1000)
+      assert.deepEqual(second.credentials.map(c => c.account), [account2])
+      assert.sameMembers(second.accounts, [account, account2])
+    })
+
+    it("lists the remaining accounts so deletions can be detected", async function() {
+      await keytar.setPassword(service, account, password)
+      await keytar.setPassword(service, account2, password2)
+      const before = await keytar.findCredentialsSince(service, 0)
+      await keytar.deletePassword(service, account)
+
+      const after = await keytar.findCredentialsSince(service, before.latest)
+      assert.deepEqual(after.accounts, [account2])
+    })
+  })
+
+  describe("agent mode", function() {
+    const agentPath = path.join(__dirname, '..', 'build', 'Release', 'keytar-agent')
+    const socket = path.join(os.tmpdir(), 'keytar-agent-spec-' + process.pid + '.sock')
+    let agent
+
+    function viaAgent(code, extraEnv) {
+      const script = 'const keytar = require(' + JSON.stringify(path.join(__dirname, '..')) + ');' +
+        '(async () => { console.log(JSON.stringify(await ' + code + ')) })()'
+      const env = Object.assign({}, process.env, {KEYTAR_AGENT_SOCKET: socket}, extraEnv)
+      return JSON.parse(childProcess.execFileSync(process.execPath, ['-e', script], {env: env}).toString())
+    }
+
+    before(function(done) {
+      if (process.platform !== 'linux' || !fs.existsSync(agentPath)) {
+        this.skip()
+      }
+      agent = childProcess.spawn(agentPath, ['--socket', socket])
+      setTimeout(done, 200)
+    })
+
+    after(function() {
+      if (agent) {
+        agent.kill()
+      }
+    })
+
+    const args = JSON.stringify(service) + ', ' + JSON.stringify(account)
+
+    // This process doesn't use the spec's agent, so its cleanup doesn't
+    // reach the agent's cache.
+    beforeEach(function() {
+      viaAgent('keytar.deletePassword(' + args + ')')
+    })
+
+    it("serves other processes from the agent's cache", async function() {
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')')
+      assert.equal(await keytar.getPassword(service, account), password)
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+    })
+
+    it("is bypassed once the keyctl backend is selected", function() {
+      const keyctl = 'keytar.configure({backend: "keyctl", keyring: "process"}), '
+      assert.equal(viaAgent('(' + keyctl + 'keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')' +
+        '.then(() => keytar.getPassword(' + args + ')))'), password)
+      assert.isNull(viaAgent('keytar.getPassword(' + args + ')'))
+    })
+
+    it("is bypassed when prompts are disabled", function() {
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')')
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+
+      // With agent mode off this write can't invalidate the agent's cache.
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password2) + ')', {KEYTAR_AGENT_SOCKET: ''})
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+      assert.equal(viaAgent('(keytar.configure({interactive: false}), keytar.getPassword(' + args + '))'), password2)
+    })
+
+    it("drops cached values after writes that bypass the agent", function() {
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')')
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+      assert.equal(viaAgent('keytar.findPassword(' + JSON.stringify(service) + ')'), password)
+
+      // Large-value calls go to libsecret directly.
+      assert.isTrue(viaAgent('keytar.deletePassword(' + args + ', {largeValue: true})'))
+      assert.isNull(viaAgent('keytar.getPassword(' + args + ')'))
+      assert.isNull(viaAgent('keytar.findPassword(' + JSON.stringify(service) + ')'))
+    })
+
+    it("drops cached values after conditional writes", function() {
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')')
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+
+      assert.isTrue(viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password2) + ', {ifChanged: true})'))
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password2)
+      assert.isTrue(viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ', {expected: ' + JSON.stringify(password2) + '})'))
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+    })
+
+    it("drops cached values after compound writes", function() {
+      viaAgent('keytar.setPassword(' + args + ', ' + JSON.stringify(password) + ')')
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+
+      assert.equal(viaAgent('keytar.replacePassword(' + args + ', ' + JSON.stringify(password2) + ')'), password)
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password2)
+
+      assert.equal(viaAgent('keytar.deleteCredentials(' + JSON.stringify(service) + ')'), 1)
+      assert.isNull(viaAgent('keytar.getPassword(' + args + ')'))
+      assert.isNull(viaAgent('keytar.findPassword(' + JSON.stringify(service) + ')'))
+
+      assert.equal(viaAgent('keytar.getOrSetPassword(' + args + ', ' + JSON.stringify(password) + ')'), password)
+      assert.equal(viaAgent('keytar.getPassword(' + args + ')'), password)
+    })
+  })
+
+  describe("keyctl backend", function() {
+    const service = 'keytar keyctl tests'
+
+    before(function() {
+      if (process.platform !== 'linux') {
+        this.skip()
+      }
+      keytar.configure({backend: 'keyctl', keyring: 'process'})
+    })
+
+    after(async function() {
+      if (process.platform === 'linux') {
+        await keytar.deleteCredentials(service)
+        keytar.configure({backend: 'default'})
+      }
+    })
+
+    it("stores, finds and deletes secrets in the kernel keyring", async function() {
+      await keytar.setPassword(service, 'a/b', 'secret')
+      await keytar.setPasswordBuffer(service, 'binary', Buffer.from([0, 255]))
+      assert.equal(await keytar.getPassword(service, 'a/b'), 'secret')
+      assert.deepEqual(await keytar.getPasswordBuffer(service, 'binary'), Buffer.from([0, 255]))
+
+      const accounts = (await keytar.findCredentials(service)).map(cred => cred.account)
+      assert.sameMembers(accounts, ['a/b', 'binary'])
+
+      assert.isTrue(await keytar.deletePassword(service, 'a/b'))
+      assert.isNull(await keytar.getPassword(service, 'a/b'))
+    })
+
+    it("expires keys written while keyTimeout is set", async function() {
+      this.timeout(5000)
+      keytar.configure({backend: 'keyctl', keyring: 'process', keyTimeout: 1})
+      try {
+        await keytar.setPassword(service, 'expiring', 'secret')
+      } finally {
+        keytar.configure({backend: 'keyctl', keyring: 'process'})
+      }
+      await keytar.setPassword(service, 'kept', 'secret')
+      assert.equal(await keytar.getPassword(service, 'expiring'), 'secret')
+
+      // The kernel checks expiry to the second.
+      await new Promise(resolve => setTimeout(resolve, 2100))
+      assert.isNull(await keytar.getPassword(service, 'expiring'))
+      assert.equal(await keytar.getPassword(service, 'kept'), 'secret')
+    })
+
+    it("expires a single key given its own keyTimeout", async function() {
+      this.timeout(5000)
+      await keytar.setPassword(service, 'expiring', 'secret', {keyTimeout: 1})
+      await keytar.setPasswordBuffer(service, 'kept', Buffer.from('secret'), {keyTimeout: 0})
+      assert.equal(await keytar.getPassword(service, 'expiring'), 'secret')
+
+      await new Promise(resolve => setTimeout(resolve, 2100))
+      assert.isNull(await keytar.getPassword(service, 'expiring'))
+      assert.equal(await keytar.getPassword(service, 'kept'), 'secret')
+    })
+
+    it("reports every entry as changed to findCredentialsSince", async function() {
+      await keytar.setPassword(service, 'a/b', 'secret')
+      const changes = await keytar.findCredentialsSince(service, Date.now() + 60000)
+      assert.include(changes.credentials.map(cred => cred.account), 'a/b')
+    })
+
+    it("rejects values the kernel can't store as one key", async function() {
+      let error
+      try {
+        await keytar.setPassword(service, 'big', 'x'.repeat(40000))
+      } catch (err) {
+        error = err
+      }
+      assert.match(error.message, /at most 32767 bytes/)
+    })
+
+    it("splits large values into chunks the kernel accepts", async function() {
+      // Chunks count against the per-user key quota, which is small by default.
+      const quota = process.getuid() === 0 ? 'root_maxbytes' : 'maxbytes'
+      if (Number(fs.readFileSync('/proc/sys/kernel/keys/' + quota, 'utf8')) < 200000) {
+        this.skip()
+      }
+      const value = require('crypto').randomBytes(100000)
+      await keytar.setPasswordBuffer(service, 'big', value, {largeValue: true})
+      assert.deepEqual(await keytar.getPasswordBuffer(service, 'big', {largeValue: true}), value)
+      assert.isTrue(await keytar.deletePassword(service, 'big', {largeValue: true}))
+    })
+
+    it("rejects collections and unknown keyrings", async function() {
+      assert.throws(() => keytar.configure({backend: 'keyctl', keyring: 'thread'}), /Unknown keyring/)
+      let error
+      try {
+        await keytar.getPassword(service, 'a/b', {collection: 'login'})
+      } catch (err) {
+        error = err
+      }
+      assert.match(error.message, /not supported by the keyctl backend/)
+    })
+  })
+
+  describe("USDT probes", function() {
+    const addon = path.join(__dirname, '..', 'build', 'Release', 'keytar.node')
+
+    it("are listed in the addon's ELF notes", function() {
+      if (process.platform !== 'linux' || !require(addon).probes) {
+        this.skip()
+      }
+
+      const notes = childProcess.execFileSync('readelf', ['-n', addon]).toString()
+      const probes = []
+      const pattern = /Provider: keytar\s+Name: (\w+)/g
+      let match
+      while ((match = pattern.exec(notes))) {
+        probes.push(match[1])
+      }
+      assert.includeMembers(probes, [
+        'worker__enqueue', 'execute__start', 'execute__done',
+        'backend__start', 'backend__done', 'callback__start', 'callback__done'
+      ])
+    })
+  })
 })
@@ -0,0 +1,154 @@
+// Tests for the keytar_core library and its asynchronous API. Built with
+// `npm run test:native`, which also runs them.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "keytar.h"
+#include "native_async.h"
+
+namespace {
+
+const char kService[] = "keytar core tests";
+const char kAccount[] = "buster";
+const char kAccount2[] = "buster2";
+
+int failures = 0;
+
+#define EXPECT(condition) \
+  do { \
+    if (!(condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": expected " \
+                << #condition << std::endl; \
+      ++failures; \
+    } \
+  } while (0)
+
+void Cleanup() {
+  std::string error;
+  keytar::DeletePassword(kService, kAccount, &error);
+  keytar::DeletePassword(kService, kAccount2, &error);
+}
+
+void TestSynchronousRoundTrip() {
+  std::string error;
+  std::string password;
+  EXPECT(keytar::SetPassword(kService, kAccount, "secret", &error) ==
+         keytar::SUCCESS);
+  EXPECT(keytar::GetPassword(kService, kAccount, &password, &error) ==
+         keytar::SUCCESS);
+  EXPECT(password == "secret");
+  EXPECT(keytar::DeletePassword(kService, kAccount, &error) ==
+         keytar::SUCCESS);
+  EXPECT(keytar::GetPassword(kService, kAccount, &password, &error) ==
+         keytar::FAIL_NONFATAL);
+}
+
+void TestFutures() {
+  EXPECT(keytar::SetPasswordAsync(kService, kAccount, "secret").get().result ==
+         keytar::SUCCESS);
+
+  keytar::PasswordResult found =
+    keytar::GetPasswordAsync(kService, kAccount).get();
+  EXPECT(found.result == keytar::SUCCESS);
+  EXPECT(found.password == "secret");
+
+  EXPECT(keytar::FindPasswordAsync(kService).get().result == keytar::SUCCESS);
+  EXPECT(keytar::DeletePasswordAsync(kService, kAccount).get().result ==
+         keytar::SUCCESS);
+  EXPECT(keytar::DeletePasswordAsync(kService, kAccount).get().result ==
+         keytar::FAIL_NONFATAL);
+  EXPECT(keytar::GetPasswordAsync(kService, kAccount).get().result ==
+         keytar::FAIL_NONFATAL);
+}
+
+void TestCallbacks() {
+  std::mutex mutex;
+  std::condition_variable done;
+  std::vector<std::string> passwords;
+
+  keytar::SetPasswordAsync(kService, kAccount, "one").get();
+  keytar::SetPasswordAsync(kService, kAccount2, "two").get();
+
+  const char* accounts[] = { kAccount, kAccount2 };
+  for (int i = 0; i < 2; ++i) {
+    keytar::GetPasswordAsync(kService, accounts[i],
+      [&](const keytar::PasswordResult& found) {
+        std::lock_guard<std::mutex> lock(mutex);
+        passwords.push_back(found.result == keytar::SUCCESS ?
+                            found.password : "<missing>");
+        done.notify_one();
+      });
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (passwords.size() < 2) {
+    done.wait(lock);
+  }
+  EXPECT((passwords[0] == "one" && passwords[1] == "two") ||
+         (passwords[0] == "two" && passwords[1] == "one"));
+}
+
+void TestConcurrentCalls() {
+  std::vector<std::future<keytar::PasswordResult> > lookups;
+  keytar::SetPasswordAsync(kService, kAccount, "secret").get();
+  for (int i = 0; i < 32; ++i) {
+    lookups.push_back(keytar::GetPasswordAsync(kService, kAccount));
+  }
+  for (size_t i = 0; i < lookups.size(); ++i) {
+    keytar::PasswordResult found = lookups[i].get();
+    EXPECT(found.result == keytar::SUCCESS && found.password == "secret");
+  }
+}
+
+}  // namespace
+
+#ifdef __linux__
+// The kernel only reports EINVAL for values it won't store as a key.
+void TestKeyctlValueLimits() {
+  std::string error;
+  keytar::BackendOptions keyctl;
+  keyctl.name = "keyctl";
+  keyctl.keyring = "process";
+  EXPECT(keytar::ConfigureBackend(keyctl, &error) == keytar::SUCCESS);
+
+  EXPECT(keytar::SetPassword(kService, kAccount, "", &error) ==
+         keytar::FAIL_ERROR);
+  EXPECT(error.find("empty values") != std::string::npos);
+  EXPECT(keytar::SetPassword(kService, kAccount, std::string(32767, 'x'),
+                             &error) == keytar::SUCCESS);
+  EXPECT(keytar::SetPassword(kService, kAccount, std::string(32768, 'x'),
+                             &error) == keytar::FAIL_ERROR);
+  EXPECT(error.find("at most 32767 bytes") != std::string::npos);
+  Cleanup();
+
+  const char* backend = getenv("KEYTAR_BACKEND");
+  keytar::BackendOptions previous;
+  previous.name = backend != NULL ? backend : "default";
+  keytar::ConfigureBackend(previous, &error);
+}
+#endif
+
+int main() {
+  Cleanup();
+  TestSynchronousRoundTrip();
+  TestFutures();
+  TestCallbacks();
+  TestConcurrentCalls();
+  Cleanup();
+#ifdef __linux__
+  TestKeyctlValueLimits();
+#endif
+
+  if (failures > 0) {
+    std::cerr << failures << " expectation(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "keytar_core: all tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+// Allocation and leak regression check for the keytar_core backends. Runs
+// each operation many times under a counting allocator and reports heap
+// allocations and live-heap growth per call, failing when any operation
+// keeps memory it doesn't release. Linux only. Built with
+// `npm run test:leaks`, which runs it against a private gnome-keyring; set
+// KEYTAR_BACKEND=keyctl to check the kernel keyring backend instead.
+//
+// Usage: keytar_leak_check [--iterations N] [--warmup N] [--max-growth BYTES]
+//
+// Builds with -fsanitize=address leave malloc to ASan, skip the counting
+// and rely on LeakSanitizer's report at exit.
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "keytar.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define KEYTAR_COUNT_ALLOCATIONS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define KEYTAR_COUNT_ALLOCATIONS 0
+#endif
+#endif
+#ifndef KEYTAR_COUNT_ALLOCATIONS
+#define KEYTAR_COUNT_ALLOCATIONS 1
+#endif
+
+namespace {
+
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> allocatedBytes(0);
+std::atomic<int64_t> liveBytes(0);
+
+}  // namespace
+
+#if KEYTAR_COUNT_ALLOCATIONS
+
+// Replaces the allocator for the whole process, including the libsecret and
+// GLib libraries the backend loads with dlopen, and forwards to glibc's.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+
+static void* Counted(void* pointer) {
+  if (pointer != NULL) {
+    size_t size = malloc_usable_size(pointer);
+    ++allocations;
+    allocatedBytes += size;
+    liveBytes += size;
+  }
+  return pointer;
+}
+
+static void Uncount(void* pointer) {
+  if (pointer != NULL)
+    liveBytes -= malloc_usable_size(pointer);
+}
+
+void* malloc(size_t size) {
+  return Counted(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size) {
+  return Counted(__libc_calloc(count, size));
+}
+
+void* realloc(void* pointer, size_t size) {
+  Uncount(pointer);
+  void* resized = __libc_realloc(pointer, size);
+  if (resized == NULL && size != 0) {
+    // The original block is still allocated.
+    if (pointer != NULL)
+      liveBytes += malloc_usable_size(pointer);
+    return NULL;
+  }
+  return Counted(resized);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  return Counted(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  return Counted(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+  void* allocated = Counted(__libc_memalign(alignment, size));
+  if (allocated == NULL)
+    return ENOMEM;
+  *pointer = allocated;
+  return 0;
+}
+
+void free(void* pointer) {
+  Uncount(pointer);
+  __libc_free(pointer);
+}
+
+}  // extern "C"
+
+#endif  // KEYTAR_COUNT_ALLOCATIONS
+
+namespace {
+
+const char kService[] = "keytar leak check";
+const char kScratchService[] = "keytar leak check scratch";
+const int kAccounts = 5;
+
+struct Operation {
+  const char* name;
+  std::function<keytar::KEYTAR_OP_RESULT(std::string*)> run;
+};
+
+std::string Account(int index) {
+  return "account" + std::to_string(index);
+}
+
+std::vector<Operation> Operations() {
+  std::vector<Operation> operations;
+  operations.push_back(Operation{"set_password", [](std::string* error) {
+    return keytar::SetPassword(kService, Account(0), "secret", error);
+  }});
+  operations.push_back(Operation{"get_password", [](std::string* error) {
+    std::string password;
+    return keytar::GetPassword(kService, Account(0), &password, error);
+  }});
+  operations.push_back(Operation{"get_password_missing", [](std::string* error) {
+    std::string password;
+    keytar::KEYTAR_OP_RESULT result =
+      keytar::GetPassword(kService, "missing", &password, error);
+    return result == keytar::FAIL_NONFATAL ? keytar::SUCCESS : result;
+  }});
+  operations.push_back(Operation{"set_password_binary", [](std::string* error) {
+    return keytar::SetPasswordBinary(kService, "binary",
+                                     std::string("\0\1\2", 3), error);
+  }});
+  operations.push_back(Operation{"get_password_binary", [](std::string* error) {
+    std::string data;
+    return keytar::GetPasswordBinary(kService, "binary", &data, error);
+  }});
+  operations.push_back(Operation{"find_password", [](std::string* error) {
+    std::string password;
+    return keytar::FindPassword(kService, &password, error);
+  }});
+  operations.push_back(Operation{"find_credentials", [](std::string* error) {
+    std::vector<keytar::Credentials> credentials;
+    return keytar::FindCredentials(kService, &credentials, error);
+  }});
+  operations.push_back(Operation{"find_secrets", [](std::string* error) {
+    std::vector<keytar::StoredSecret> secrets;
+    return keytar::FindSecrets(kService, &secrets, error);
+  }});
+  operations.push_back(Operation{"set_and_delete_password", [](std::string* error) {
+    keytar::KEYTAR_OP_RESULT result =
+      keytar::SetPassword(kScratchService, "scratch", "secret", error);
+    if (result != keytar::SUCCESS)
+      return result;
+    return keytar::DeletePassword(kScratchService, "scratch", error);
+  }});
+  operations.push_back(Operation{"delete_password_missing", [](std::string* error) {
+    keytar::KEYTAR_OP_RESULT result =
+      keytar::DeletePassword(kScratchService, "missing", error);
+    return result == keytar::FAIL_NONFATAL ? keytar::SUCCESS : result;
+  }});
+  operations.push_back(Operation{"set_and_delete_credentials", [](std::string* error) {
+    keytar::KEYTAR_OP_RESULT result =
+      keytar::SetPassword(kScratchService, "scratch", "secret", error);
+    if (result != keytar::SUCCESS)
+      return result;
+    size_t count = 0;
+    return keytar::DeleteCredentials(kScratchService, &count, error);
+  }});
+  return operations;
+}
+
+void Cleanup() {
+  std::string error;
+  size_t count = 0;
+  keytar::DeleteCredentials(kService, &count, &error);
+  keytar::DeleteCredentials(kScratchService, &count, &error);
+}
+
+bool ParseArgs(int argc, char** argv, int* iterations, int* warmup,
+               int64_t* maxGrowth) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--iterations") == 0) {
+      *iterations = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--warmup") == 0) {
+      *warmup = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--max-growth") == 0) {
+      *maxGrowth = atoll(argv[i + 1]);
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1 && *iterations > 0 && *warmup >= 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 200;
+  int warmup = 20;
+  // Bytes per call. Allows for GLib and D-Bus bookkeeping on other threads
+  // that happens to land inside a measurement.
+  int64_t maxGrowth = 16;
+  if (!ParseArgs(argc, argv, &iterations, &warmup, &maxGrowth)) {
+    fprintf(stderr, "Usage: %s [--iterations N] [--warmup N] "
+                    "[--max-growth BYTES]\n", argv[0]);
+    return 2;
+  }
+
+  Cleanup();
+  std::string error;
+  for (int i = 0; i < kAccounts; ++i) {
+    if (keytar::SetPassword(kService, Account(i), "secret", &error) !=
+        keytar::SUCCESS) {
+      fprintf(stderr, "Cannot store test entries: %s\n", error.c_str());
+      return 2;
+    }
+  }
+
+  if (!KEYTAR_COUNT_ALLOCATIONS)
+    printf("Built with AddressSanitizer: leaks are reported at exit.\n");
+  printf("%-28s %12s %14s %16s\n",
+         "operation", "allocs/call", "bytes/call", "growth/call");
+
+  int failed = 0;
+  std::vector<Operation> operations = Operations();
+  for (size_t i = 0; i < operations.size(); ++i) {
+    const Operation& operation = operations[i];
+    // Warm-up calls fill the caches (D-Bus connection, item paths, opened
+    // collections) that legitimately live for the rest of the process.
+    for (int j = 0; j < warmup; ++j) {
+      if (operation.run(&error) != keytar::SUCCESS) {
+        fprintf(stderr, "%s failed: %s\n", operation.name, error.c_str());
+        Cleanup();
+        return 2;
+      }
+    }
+
+    uint64_t startAllocations = allocations;
+    uint64_t startBytes = allocatedBytes;
+    int64_t startLive = liveBytes;
+    for (int j = 0; j < iterations; ++j)
+      operation.run(&error);
+    double calls = iterations;
+    double growth = (liveBytes - startLive) / calls;
+
+    bool leaks = KEYTAR_COUNT_ALLOCATIONS && growth > maxGrowth;
+    printf("%-28s %12.1f %14.1f %16.1f%s\n",
+           operation.name,
+           (allocations - startAllocations) / calls,
+           (allocatedBytes - startBytes) / calls,
+           growth,
+           leaks ? "  LEAK" : "");
+    if (leaks)
+      ++failed;
+  }
+
+  Cleanup();
+  if (failed > 0) {
+    fprintf(stderr, "%d operation(s) grew the heap by more than %lld bytes "
+                    "per call\n", failed, static_cast<long long>(maxGrowth));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+#include "agent_client.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <vector>
+
+#include "agent_protocol.h"
+#include "keytar_keyctl.h"
+
+namespace keytar {
+namespace agent {
+
+namespace {
+
+// Connections are pooled so concurrent workers don't serialize on a single
+// socket, but idle ones beyond this count are closed.
+const size_t kMaxIdleConnections = 8;
+
+// After a failed connect the agent is assumed absent for this long, so
+// processes without an agent don't pay a connect() on every operation.
+const time_t kRetryIntervalSeconds = 5;
+
+std::mutex poolMutex;
+std::vector<int> idleConnections;
+time_t retryAfter = 0;
+
+time_t Now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec;
+}
+
+int Connect() {
+  std::string path = SocketPath();
+  if (path.empty() || path.size() >= sizeof(sockaddr_un().sun_path))
+    return -1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, path.data(), path.size());
+
+  int status;
+  do {
+    status = connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+                     sizeof(address));
+  } while (status != 0 && errno == EINTR);
+
+  // Only talk to an agent running as our own user; anything else could be
+  // impersonating it to harvest secrets.
+  if (status != 0 || !PeerIsSameUser(fd)) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!idleConnections.empty()) {
+      int fd = idleConnections.back();
+      idleConnections.pop_back();
+      return fd;
+    }
+    if (Now() < retryAfter)
+      return -1;
+  }
+
+  int fd = Connect();
+  if (fd < 0) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    retryAfter = Now() + kRetryIntervalSeconds;
+  }
+  return fd;
+}
+
+void Release(int fd) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  if (idleConnections.size() < kMaxIdleConnections) {
+    idleConnections.push_back(fd);
+  } else {
+    close(fd);
+  }
+}
+
+bool Call(const AgentRequest& request, AgentResponse* response) {
+  // The agent serves the Secret Service, so once this process has switched
+  // to the kernel keyring it must not read or write through the agent.
+  if (keyctl::Enabled())
+    return false;
+
+  int fd = Acquire();
+  if (fd < 0)
+    return false;
+
+  if (!WriteRequest(fd, request) || !ReadResponse(fd, response)) {
+    // The agent went away mid-call; drop the connection and let the caller
+    // fall back to the backend. Every operation we forward is idempotent.
+    close(fd);
+    return false;
+  }
+
+  Release(fd);
+  return true;
+}
+
+bool Forward(const AgentRequest& request,
+             std::string* value,
+             KEYTAR_OP_RESULT* result,
+             std::string* error) {
+  // The agent's backend may prompt to unlock a collection, so calls that
+  // must not prompt go to the backend directly, which fails them with
+  // kLockedError instead.
+  if (!Interactive())
+    return false;
+
+  AgentResponse response;
+  if (!Call(request, &response))
+    return false;
+
+  *result = response.result;
+  if (response.result == FAIL_ERROR) {
+    *error = response.payload;
+  } else if (response.result == SUCCESS && value != NULL) {
+    value->swap(response.payload);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool SetPassword(const std::string& service,
+                 const std::string& account,
+                 const std::string& password,
+                 bool binary,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error) {
+  AgentRequest request;
+  request.op = binary ? OP_SET_PASSWORD_BINARY : OP_SET_PASSWORD;
+  request.service = service;
+  request.account = account;
+  request.password = password;
+  return Forward(request, NULL, result, error);
+}
+
+bool GetPassword(const std::string& service,
+                 const std::string& account,
+                 bool binary,
+                 std::string* password,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error) {
+  AgentRequest request;
+  request.op = binary ? OP_GET_PASSWORD_BINARY : OP_GET_PASSWORD;
+  request.service = service;
+  request.account = account;
+  return Forward(request, password, result, error);
+}
+
+bool DeletePassword(const std::string& service,
+                    const std::string& account,
+                    KEYTAR_OP_RESULT* result,
+                    std::string* error) {
+  AgentRequest request;
+  request.op = OP_DELETE_PASSWORD;
+  request.service = service;
+  request.account = account;
+  return Forward(request, NULL, result, error);
+}
+
+bool FindPassword(const std::string& service,
+                  std::string* password,
+                  KEYTAR_OP_RESULT* result,
+                  std::string* error) {
+  AgentRequest request;
+  request.op = OP_FIND_PASSWORD;
+  request.service = service;
+  return Forward(request, password, result, error);
+}
+
+void Invalidate(const std::string& service) {
+  AgentRequest request;
+  request.op = OP_INVALIDATE;
+  request.service = service;
+  AgentResponse response;
+  Call(request, &response);
+}
+
+void CloseIdleConnections() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  for (size_t i = 0; i < idleConnections.size(); ++i)
+    close(idleConnections[i]);
+  idleConnections.clear();
+}
+
+}  // namespace agent
+}  // namespace keytar
+
+#else  // defined(__linux__)
+
+namespace keytar {
+namespace agent {
+
+// The agent is only built for Linux; elsewhere every call goes straight to
+// the backend.
+
+bool SetPassword(const std::string& service,
+                 const std::string& account,
+                 const std::string& password,
+                 bool binary,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error) {
+  return false;
+}
+
+bool GetPassword(const std::string& service,
+                 const std::string& account,
+                 bool binary,
+                 std::string* password,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error) {
+  return false;
+}
+
+bool DeletePassword(const std::string& service,
+                    const std::string& account,
+                    KEYTAR_OP_RESULT* result,
+                    std::string* error) {
+  return false;
+}
+
+bool FindPassword(const std::string& service,
+                  std::string* password,
+                  KEYTAR_OP_RESULT* result,
+                  std::string* error) {
+  return false;
+}
+
+void Invalidate(const std::string& service) {
+}
+
+void CloseIdleConnections() {
+}
+
+}  // namespace agent
+}  // namespace keytar
+
+#endif  // defined(__linux__)
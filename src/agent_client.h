@@ -0,0 +1,51 @@
+#ifndef SRC_AGENT_CLIENT_H_
+#define SRC_AGENT_CLIENT_H_
+
+#include <string>
+
+#include "keytar.h"
+
+namespace keytar {
+namespace agent {
+
+// Forwards an operation to a running keytar-agent. Each call returns false
+// when no agent is reachable, when the keyctl backend is selected or when
+// prompts are disabled, in which case the caller is expected to talk to
+// the backend directly; otherwise `result` holds the agent's answer.
+
+bool SetPassword(const std::string& service,
+                 const std::string& account,
+                 const std::string& password,
+                 bool binary,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error);
+
+bool GetPassword(const std::string& service,
+                 const std::string& account,
+                 bool binary,
+                 std::string* password,
+                 KEYTAR_OP_RESULT* result,
+                 std::string* error);
+
+bool DeletePassword(const std::string& service,
+                    const std::string& account,
+                    KEYTAR_OP_RESULT* result,
+                    std::string* error);
+
+bool FindPassword(const std::string& service,
+                  std::string* password,
+                  KEYTAR_OP_RESULT* result,
+                  std::string* error);
+
+// Tells the agent to drop what it cached for `service`. Call after every
+// write that went to the backend directly, so other clients of the agent
+// don't keep reading the old value until it expires.
+void Invalidate(const std::string& service);
+
+// Closes the pooled connections to the agent that no call is using.
+void CloseIdleConnections();
+
+}  // namespace agent
+}  // namespace keytar
+
+#endif  // SRC_AGENT_CLIENT_H_
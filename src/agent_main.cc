@@ -0,0 +1,285 @@
+// keytar-agent: holds a single backend connection and an in-memory cache on
+// behalf of every keytar process of the same user on this host. Clients
+// connect over a Unix domain socket; see agent_protocol.h for the format.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "agent_protocol.h"
+#include "keytar.h"
+
+namespace {
+
+using keytar::KEYTAR_OP_RESULT;
+using keytar::agent::AgentRequest;
+using keytar::agent::AgentResponse;
+
+// Cached values expire so that writes made without going through the agent
+// (other users of the keyring, the seahorse UI, ...) become visible.
+const int kDefaultCacheTtlSeconds = 30;
+
+struct CacheEntry {
+  std::string value;
+  time_t expires;
+};
+
+std::mutex cacheMutex;
+std::unordered_map<std::string, CacheEntry> cache;
+// Bumped by every write to a service and every invalidation of it. A read
+// only caches its result when the generation didn't change while it was
+// talking to the backend, since it may have read the value a concurrent
+// write has just replaced.
+std::unordered_map<std::string, uint64_t> generations;
+int cacheTtl = kDefaultCacheTtlSeconds;
+std::string socketPath;
+
+time_t Now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec;
+}
+
+// Text and binary reads of the same item return different results on Linux,
+// so they are cached separately. FindPassword is cached per service.
+std::string CacheKey(char kind, const std::string& service,
+                     const std::string& account) {
+  std::string key(1, kind);
+  key.append(service);
+  key.push_back('\0');
+  key.append(account);
+  return key;
+}
+
+uint64_t Generation(const std::string& service) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::unordered_map<std::string, uint64_t>::const_iterator it =
+    generations.find(service);
+  return it == generations.end() ? 0 : it->second;
+}
+
+bool CacheLookup(const std::string& key, std::string* value) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::unordered_map<std::string, CacheEntry>::iterator it = cache.find(key);
+  if (it == cache.end())
+    return false;
+  if (it->second.expires <= Now()) {
+    cache.erase(it);
+    return false;
+  }
+  *value = it->second.value;
+  return true;
+}
+
+void CacheStore(const std::string& key, const std::string& service,
+                uint64_t generation, const std::string& value) {
+  if (cacheTtl <= 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::unordered_map<std::string, uint64_t>::const_iterator it =
+    generations.find(service);
+  if ((it == generations.end() ? 0 : it->second) != generation)
+    return;
+  CacheEntry& entry = cache[key];
+  entry.value = value;
+  entry.expires = Now() + cacheTtl;
+}
+
+void CacheInvalidate(const std::string& service, const std::string& account) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  ++generations[service];
+  cache.erase(CacheKey('t', service, account));
+  cache.erase(CacheKey('b', service, account));
+  cache.erase(CacheKey('f', service, std::string()));
+}
+
+void CacheInvalidate(const std::string& service) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  ++generations[service];
+  std::string prefix = service;
+  prefix.push_back('\0');
+  std::unordered_map<std::string, CacheEntry>::iterator it = cache.begin();
+  while (it != cache.end()) {
+    if (it->first.compare(1, prefix.size(), prefix) == 0) {
+      it = cache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+KEYTAR_OP_RESULT Get(char kind, const AgentRequest& request,
+                     std::string* value, std::string* error) {
+  std::string key = CacheKey(kind, request.service, request.account);
+  if (CacheLookup(key, value))
+    return keytar::SUCCESS;
+
+  uint64_t generation = Generation(request.service);
+  KEYTAR_OP_RESULT result;
+  if (kind == 'f') {
+    result = keytar::FindPassword(request.service, value, error);
+  } else if (kind == 'b') {
+    result = keytar::GetPasswordBinary(request.service, request.account,
+                                       value, error);
+  } else {
+    result = keytar::GetPassword(request.service, request.account,
+                                 value, error);
+  }
+
+  if (result == keytar::SUCCESS)
+    CacheStore(key, request.service, generation, *value);
+  return result;
+}
+
+AgentResponse Handle(const AgentRequest& request) {
+  AgentResponse response;
+  std::string error;
+
+  switch (request.op) {
+    case keytar::agent::OP_GET_PASSWORD:
+      response.result = Get('t', request, &response.payload, &error);
+      break;
+    case keytar::agent::OP_GET_PASSWORD_BINARY:
+      response.result = Get('b', request, &response.payload, &error);
+      break;
+    case keytar::agent::OP_FIND_PASSWORD:
+      response.result = Get('f', request, &response.payload, &error);
+      break;
+    // Writes invalidate before the backend call, so reads stop being served
+    // the old value, and after it. Reads that overlapped the write see the
+    // generation change and don't cache what they read.
+    case keytar::agent::OP_SET_PASSWORD:
+    case keytar::agent::OP_SET_PASSWORD_BINARY:
+      CacheInvalidate(request.service, request.account);
+      if (request.op == keytar::agent::OP_SET_PASSWORD_BINARY) {
+        response.result = keytar::SetPasswordBinary(
+          request.service, request.account, request.password, &error);
+      } else {
+        response.result = keytar::SetPassword(
+          request.service, request.account, request.password, &error);
+      }
+      CacheInvalidate(request.service, request.account);
+      break;
+    case keytar::agent::OP_DELETE_PASSWORD:
+      CacheInvalidate(request.service, request.account);
+      response.result = keytar::DeletePassword(
+        request.service, request.account, &error);
+      CacheInvalidate(request.service, request.account);
+      break;
+    case keytar::agent::OP_INVALIDATE:
+      CacheInvalidate(request.service);
+      response.result = keytar::SUCCESS;
+      break;
+    default:
+      response.result = keytar::FAIL_ERROR;
+      error = "Unknown agent operation.";
+      break;
+  }
+
+  if (response.result == keytar::FAIL_ERROR) {
+    response.payload = error;
+  } else if (response.result == keytar::FAIL_NONFATAL) {
+    response.payload.clear();
+  }
+  return response;
+}
+
+void Serve(int fd) {
+  AgentRequest request;
+  while (keytar::agent::ReadRequest(fd, &request)) {
+    if (!keytar::agent::WriteResponse(fd, Handle(request)))
+      break;
+  }
+  close(fd);
+}
+
+void Shutdown(int) {
+  unlink(socketPath.c_str());
+  _exit(0);
+}
+
+void Usage() {
+  fprintf(stderr,
+          "Usage: keytar-agent [--socket PATH] [--cache-ttl SECONDS]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  socketPath = keytar::agent::SocketPath();
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else if (strcmp(argv[i], "--cache-ttl") == 0 && i + 1 < argc) {
+      cacheTtl = atoi(argv[++i]);
+    } else {
+      Usage();
+      return 2;
+    }
+  }
+
+  struct sockaddr_un address;
+  if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+    fprintf(stderr, "keytar-agent: no usable socket path; set "
+                    "XDG_RUNTIME_DIR or pass --socket.\n");
+    return 1;
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    perror("keytar-agent: socket");
+    return 1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+  // The socket is only ever reachable by its owner; connections from other
+  // users are additionally rejected through SO_PEERCRED below.
+  unlink(socketPath.c_str());
+  mode_t oldMask = umask(0177);
+  int status = bind(listener, reinterpret_cast<struct sockaddr*>(&address),
+                    sizeof(address));
+  umask(oldMask);
+  if (status != 0 || listen(listener, SOMAXCONN) != 0) {
+    perror("keytar-agent: bind");
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, Shutdown);
+  signal(SIGTERM, Shutdown);
+
+  for (;;) {
+    int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      perror("keytar-agent: accept");
+      return 1;
+    }
+
+    if (!keytar::agent::PeerIsSameUser(fd)) {
+      close(fd);
+      continue;
+    }
+
+    std::thread(Serve, fd).detach();
+  }
+}
@@ -0,0 +1,171 @@
+#include "agent_protocol.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace keytar {
+namespace agent {
+
+namespace {
+
+const char kSocketName[] = "keytar-agent.sock";
+
+void PutUint32(std::string* out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void PutString(std::string* out, const std::string& value) {
+  PutUint32(out, static_cast<uint32_t>(value.size()));
+  out->append(value);
+}
+
+bool GetUint32(const std::string& in, size_t* offset, uint32_t* value) {
+  if (in.size() - *offset < 4)
+    return false;
+
+  *value = 0;
+  for (int i = 0; i < 4; ++i) {
+    *value |= static_cast<uint32_t>(
+      static_cast<unsigned char>(in[*offset + i])) << (8 * i);
+  }
+  *offset += 4;
+  return true;
+}
+
+bool GetString(const std::string& in, size_t* offset, std::string* value) {
+  uint32_t length;
+  if (!GetUint32(in, offset, &length) || in.size() - *offset < length)
+    return false;
+
+  value->assign(in, *offset, length);
+  *offset += length;
+  return true;
+}
+
+bool WriteAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* data, size_t length) {
+  while (length > 0) {
+    ssize_t got = recv(fd, data, length, 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    data += got;
+    length -= got;
+  }
+  return true;
+}
+
+bool WriteFrame(int fd, const std::string& body) {
+  std::string frame;
+  frame.reserve(4 + body.size());
+  PutUint32(&frame, static_cast<uint32_t>(body.size()));
+  frame.append(body);
+  return WriteAll(fd, frame.data(), frame.size());
+}
+
+bool ReadFrame(int fd, std::string* body) {
+  std::string header(4, '\0');
+  if (!ReadAll(fd, &header[0], header.size()))
+    return false;
+
+  size_t offset = 0;
+  uint32_t length;
+  GetUint32(header, &offset, &length);
+  if (length > kMaxFrameSize)
+    return false;
+
+  body->resize(length);
+  return length == 0 || ReadAll(fd, &(*body)[0], length);
+}
+
+}  // namespace
+
+bool WriteRequest(int fd, const AgentRequest& request) {
+  std::string body;
+  body.push_back(static_cast<char>(kProtocolVersion));
+  body.push_back(static_cast<char>(request.op));
+  PutString(&body, request.service);
+  PutString(&body, request.account);
+  PutString(&body, request.password);
+  return WriteFrame(fd, body);
+}
+
+bool ReadRequest(int fd, AgentRequest* request) {
+  std::string body;
+  if (!ReadFrame(fd, &body) || body.size() < 2 ||
+      static_cast<uint8_t>(body[0]) != kProtocolVersion) {
+    return false;
+  }
+
+  request->op = static_cast<uint8_t>(body[1]);
+  size_t offset = 2;
+  return GetString(body, &offset, &request->service) &&
+    GetString(body, &offset, &request->account) &&
+    GetString(body, &offset, &request->password) &&
+    offset == body.size();
+}
+
+bool WriteResponse(int fd, const AgentResponse& response) {
+  std::string body;
+  body.push_back(static_cast<char>(response.result));
+  PutString(&body, response.payload);
+  return WriteFrame(fd, body);
+}
+
+bool ReadResponse(int fd, AgentResponse* response) {
+  std::string body;
+  if (!ReadFrame(fd, &body) || body.empty())
+    return false;
+
+  uint8_t result = static_cast<uint8_t>(body[0]);
+  if (result > FAIL_NONFATAL)
+    return false;
+
+  response->result = static_cast<KEYTAR_OP_RESULT>(result);
+  size_t offset = 1;
+  return GetString(body, &offset, &response->payload) &&
+    offset == body.size();
+}
+
+std::string SocketPath() {
+  const char* path = getenv("KEYTAR_AGENT_SOCKET");
+  if (path != NULL)
+    return path;
+
+  const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+  if (runtimeDir != NULL && runtimeDir[0] != '\0')
+    return std::string(runtimeDir) + "/" + kSocketName;
+
+  return std::string();
+}
+
+bool PeerIsSameUser(int fd) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+    return false;
+  return credentials.uid == geteuid();
+}
+
+}  // namespace agent
+}  // namespace keytar
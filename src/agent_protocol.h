@@ -0,0 +1,70 @@
+#ifndef SRC_AGENT_PROTOCOL_H_
+#define SRC_AGENT_PROTOCOL_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "keytar.h"
+
+namespace keytar {
+namespace agent {
+
+// Wire protocol spoken between the addon and keytar-agent over a Unix
+// domain socket. Every frame is a little-endian u32 body length followed by
+// the body. A request body is
+//   version u8 | op u8 | service | account | password
+// and a response body is
+//   result u8 | payload
+// where each string is a u32 length followed by its bytes. The payload holds
+// the secret on success and the error message on FAIL_ERROR. OP_INVALIDATE
+// only uses the service: it drops every cached value of that service after
+// a client wrote to the backend without going through the agent.
+const uint8_t kProtocolVersion = 1;
+
+// Frames larger than this are rejected so a bad peer can't make the other
+// side allocate unbounded memory.
+const uint32_t kMaxFrameSize = 64 * 1024 * 1024;
+
+enum AgentOp {
+  OP_GET_PASSWORD = 1,
+  OP_SET_PASSWORD = 2,
+  OP_DELETE_PASSWORD = 3,
+  OP_FIND_PASSWORD = 4,
+  OP_GET_PASSWORD_BINARY = 5,
+  OP_SET_PASSWORD_BINARY = 6,
+  OP_INVALIDATE = 7
+};
+
+struct AgentRequest {
+  uint8_t op;
+  std::string service;
+  std::string account;
+  std::string password;
+};
+
+struct AgentResponse {
+  KEYTAR_OP_RESULT result;
+  std::string payload;
+};
+
+// Each returns false on I/O errors or malformed frames, after which the
+// connection must be closed.
+bool WriteRequest(int fd, const AgentRequest& request);
+bool ReadRequest(int fd, AgentRequest* request);
+bool WriteResponse(int fd, const AgentResponse& response);
+bool ReadResponse(int fd, AgentResponse* response);
+
+// Returns the socket path the agent listens on: $KEYTAR_AGENT_SOCKET if set,
+// otherwise keytar-agent.sock inside $XDG_RUNTIME_DIR. Returns an empty
+// string when neither is set, which disables agent mode.
+std::string SocketPath();
+
+// Returns true when the process on the other end of `fd` runs as the same
+// user as this one.
+bool PeerIsSameUser(int fd);
+
+}  // namespace agent
+}  // namespace keytar
+
+#endif  // SRC_AGENT_PROTOCOL_H_
@@ -1,34 +1,156 @@
+#include <string.h>
+
 #include <string>
 #include <vector>
 
 #include "nan.h"
 #include "keytar.h"
+#include "large_value.h"
+#include "operations.h"
+#include "packed_credentials.h"
+#include "preload.h"
+#include "probes.h"
+#include "secret_fd.h"
+#include "agent_client.h"
 #include "async.h"
 
 #include <iostream>
 
+#include <openssl/crypto.h>
+
 using keytar::KEYTAR_OP_RESULT;
 
+void CallWithPreloaded(v8::Local<v8::Value> callback,
+                       bool found,
+                       const std::string& password,
+                       bool binary) {
+        v8::Local<v8::Value> val = Nan::Null();
+        if (found && binary) {
+                val = Nan::CopyBuffer(password.data(),
+                                      password.length()).ToLocalChecked();
+        } else if (found) {
+                val = Nan::New<v8::String>(password.data(),
+                                           password.length()).ToLocalChecked();
+        }
+        v8::Local<v8::Value> argv[] = { Nan::Null(), val };
+        Nan::Callback(callback.As<v8::Function>()).Call(2, argv);
+}
+
+KeytarWorker::KeytarWorker(
+        const char* operation,
+        Nan::Callback* callback
+        ) : AsyncWorker(callback),
+        operation(operation),
+        status(keytar::SUCCESS) {
+}
+
+void KeytarWorker::Queue() {
+        KEYTAR_PROBE1(worker__enqueue, operation);
+        Nan::AsyncQueueWorker(this);
+}
+
+void KeytarWorker::Execute() {
+        KEYTAR_PROBE1(execute__start, operation);
+        Run();
+        KEYTAR_PROBE2(execute__done, operation, status);
+}
+
+void KeytarWorker::WorkComplete() {
+        KEYTAR_PROBE1(callback__start, operation);
+        AsyncWorker::WorkComplete();
+        KEYTAR_PROBE1(callback__done, operation);
+}
+
+void KeytarWorker::HandleErrorCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> error = Nan::Error(ErrorMessage());
+        if (strcmp(ErrorMessage(), keytar::kLockedError) == 0) {
+                Nan::Set(error.As<v8::Object>(),
+                         Nan::New("code").ToLocalChecked(),
+                         Nan::New("ERR_KEYTAR_LOCKED").ToLocalChecked());
+        }
+        v8::Local<v8::Value> argv[] = {
+                error
+        };
+
+        callback->Call(1, argv);
+}
+
+
+
 SetPasswordWorker::SetPasswordWorker(
         const std::string& service,
         const std::string& account,
         const std::string& password,
-        Nan::Callback* callback
-        ) : AsyncWorker(callback),
-        service(service),
-        account(account),
-        password(password) {
+        Nan::Callback* callback,
+        bool binary,
+        const std::string& collection,
+        int64_t timeout
+        ) : KeytarWorker("set_password", callback),
+        key(std::make_shared<CredentialKey>(service, account)),
+        service(key->service),
+        account(key->account),
+        password(password),
+        binary(binary),
+        collection(collection),
+        timeout(timeout) {
+}
+
+SetPasswordWorker::SetPasswordWorker(
+        const std::shared_ptr<const CredentialKey>& key,
+        const std::string& password,
+        Nan::Callback* callback,
+        bool binary
+        ) : KeytarWorker("set_password", callback),
+        key(key),
+        service(key->service),
+        account(key->account),
+        password(password),
+        binary(binary),
+        timeout(-1) {
 }
 
 SetPasswordWorker::~SetPasswordWorker() {
 }
 
-void SetPasswordWorker::Execute() {
+void SetPasswordWorker::Run() {
         std::string error;
-        KEYTAR_OP_RESULT result = keytar::SetPassword(service,
-                                                      account,
-                                                      password,
-                                                      &error);
+        KEYTAR_OP_RESULT result;
+        bool direct = true;
+        if (!collection.empty()) {
+                result = keytar::SetPasswordInCollection(collection,
+                                                         service,
+                                                         account,
+                                                         password,
+                                                         binary,
+                                                         &error);
+        } else if (timeout >= 0) {
+                result = keytar::SetPasswordWithTimeout(
+                        service,
+                        account,
+                        password,
+                        binary,
+                        static_cast<unsigned int>(timeout),
+                        &error);
+        } else if (keytar::agent::SetPassword(service, account, password, binary,
+                                              &result, &error)) {
+                // Served by keytar-agent, which updated its own cache.
+                direct = false;
+        } else if (binary) {
+                result = keytar::SetPasswordBinary(service,
+                                                   account,
+                                                   password,
+                                                   &error);
+        } else {
+                result = keytar::SetPassword(service,
+                                             account,
+                                             password,
+                                             &error);
+        }
+        keytar::InvalidatePreloaded(service, account);
+        if (direct)
+                keytar::agent::Invalidate(service);
+        status = result;
         if (result == keytar::FAIL_ERROR) {
                 SetErrorMessage(error.c_str());
         }
@@ -39,21 +161,56 @@ void SetPasswordWorker::Execute() {
 GetPasswordWorker::GetPasswordWorker(
         const std::string& service,
         const std::string& account,
-        Nan::Callback* callback
-        ) : AsyncWorker(callback),
-        service(service),
-        account(account) {
+        Nan::Callback* callback,
+        bool binary,
+        const std::string& collection
+        ) : KeytarWorker("get_password", callback),
+        key(std::make_shared<CredentialKey>(service, account)),
+        service(key->service),
+        account(key->account),
+        binary(binary),
+        collection(collection) {
+}
+
+GetPasswordWorker::GetPasswordWorker(
+        const std::shared_ptr<const CredentialKey>& key,
+        Nan::Callback* callback,
+        bool binary
+        ) : KeytarWorker("get_password", callback),
+        key(key),
+        service(key->service),
+        account(key->account),
+        binary(binary) {
 }
 
 GetPasswordWorker::~GetPasswordWorker() {
 }
 
-void GetPasswordWorker::Execute() {
+void GetPasswordWorker::Run() {
         std::string error;
-        KEYTAR_OP_RESULT result = keytar::GetPassword(service,
-                                                      account,
-                                                      &password,
-                                                      &error);
+        KEYTAR_OP_RESULT result;
+        if (!collection.empty()) {
+                result = keytar::GetPasswordInCollection(collection,
+                                                         service,
+                                                         account,
+                                                         binary,
+                                                         &password,
+                                                         &error);
+        } else if (keytar::agent::GetPassword(service, account, binary, &password,
+                                              &result, &error)) {
+                // Served by keytar-agent.
+        } else if (binary) {
+                result = keytar::GetPasswordBinary(service,
+                                                   account,
+                                                   &password,
+                                                   &error);
+        } else {
+                result = keytar::GetPassword(service,
+                                             account,
+                                             &password,
+                                             &error);
+        }
+        status = result;
         if (result == keytar::FAIL_ERROR) {
                 SetErrorMessage(error.c_str());
         } else if (result == keytar::FAIL_NONFATAL) {
@@ -66,7 +223,10 @@ void GetPasswordWorker::Execute() {
 void GetPasswordWorker::HandleOKCallback() {
         Nan::HandleScope scope;
         v8::Local<v8::Value> val = Nan::Null();
-        if (success) {
+        if (success && binary) {
+                val = Nan::CopyBuffer(password.data(),
+                                      password.length()).ToLocalChecked();
+        } else if (success) {
                 val = Nan::New<v8::String>(password.data(),
                                            password.length()).ToLocalChecked();
         }
@@ -83,18 +243,46 @@ void GetPasswordWorker::HandleOKCallback() {
 DeletePasswordWorker::DeletePasswordWorker(
         const std::string& service,
         const std::string& account,
+        Nan::Callback* callback,
+        const std::string& collection
+        ) : KeytarWorker("delete_password", callback),
+        key(std::make_shared<CredentialKey>(service, account)),
+        service(key->service),
+        account(key->account),
+        collection(collection) {
+}
+
+DeletePasswordWorker::DeletePasswordWorker(
+        const std::shared_ptr<const CredentialKey>& key,
         Nan::Callback* callback
-        ) : AsyncWorker(callback),
-        service(service),
-        account(account) {
+        ) : KeytarWorker("delete_password", callback),
+        key(key),
+        service(key->service),
+        account(key->account) {
 }
 
 DeletePasswordWorker::~DeletePasswordWorker() {
 }
 
-void DeletePasswordWorker::Execute() {
+void DeletePasswordWorker::Run() {
         std::string error;
-        KEYTAR_OP_RESULT result = keytar::DeletePassword(service, account, &error);
+        KEYTAR_OP_RESULT result;
+        bool direct = true;
+        if (!collection.empty()) {
+                result = keytar::DeletePasswordInCollection(collection,
+                                                            service,
+                                                            account,
+                                                            &error);
+        } else if (keytar::agent::DeletePassword(service, account, &result, &error)) {
+                // Served by keytar-agent, which updated its own cache.
+                direct = false;
+        } else {
+                result = keytar::DeletePassword(service, account, &error);
+        }
+        keytar::InvalidatePreloaded(service, account);
+        if (direct)
+                keytar::agent::Invalidate(service);
+        status = result;
         if (result == keytar::FAIL_ERROR) {
                 SetErrorMessage(error.c_str());
         } else if (result == keytar::FAIL_NONFATAL) {
@@ -120,19 +308,30 @@ void DeletePasswordWorker::HandleOKCallback() {
 
 FindPasswordWorker::FindPasswordWorker(
         const std::string& service,
-        Nan::Callback* callback
-        ) : AsyncWorker(callback),
-        service(service) {
+        Nan::Callback* callback,
+        const std::string& collection
+        ) : KeytarWorker("find_password", callback),
+        service(service),
+        collection(collection) {
 }
 
 FindPasswordWorker::~FindPasswordWorker() {
 }
 
-void FindPasswordWorker::Execute() {
+void FindPasswordWorker::Run() {
         std::string error;
-        KEYTAR_OP_RESULT result = keytar::FindPassword(service,
-                                                       &password,
-                                                       &error);
+        KEYTAR_OP_RESULT result;
+        if (!collection.empty()) {
+                result = keytar::FindPasswordInCollection(collection,
+                                                          service,
+                                                          &password,
+                                                          &error);
+        } else if (!keytar::agent::FindPassword(service, &password, &result, &error)) {
+                result = keytar::FindPassword(service,
+                                              &password,
+                                              &error);
+        }
+        status = result;
         if (result == keytar::FAIL_ERROR) {
                 SetErrorMessage(error.c_str());
         } else if (result == keytar::FAIL_NONFATAL) {
@@ -161,19 +360,32 @@ void FindPasswordWorker::HandleOKCallback() {
 
 FindCredentialsWorker::FindCredentialsWorker(
         const std::string& service,
-        Nan::Callback* callback
-        ) : AsyncWorker(callback),
-        service(service) {
+        Nan::Callback* callback,
+        const std::vector<std::string>& collections,
+        bool packed
+        ) : KeytarWorker("find_credentials", callback),
+        service(service),
+        collections(collections),
+        packed(packed) {
 }
 
 FindCredentialsWorker::~FindCredentialsWorker() {
 }
 
-void FindCredentialsWorker::Execute() {
+void FindCredentialsWorker::Run() {
         std::string error;
-        KEYTAR_OP_RESULT result = keytar::FindCredentials(service,
-                                                          &credentials,
-                                                          &error);
+        KEYTAR_OP_RESULT result;
+        if (!collections.empty()) {
+                result = keytar::FindCredentialsInCollections(collections,
+                                                              service,
+                                                              &credentials,
+                                                              &error);
+        } else {
+                result = keytar::FindCredentials(service,
+                                                 &credentials,
+                                                 &error);
+        }
+        status = result;
         if (result == keytar::FAIL_ERROR) {
                 SetErrorMessage(error.c_str());
         } else if (result == keytar::FAIL_NONFATAL) {
@@ -181,52 +393,71 @@ void FindCredentialsWorker::Execute() {
         } else {
                 success = true;
         }
+
+        // Pack on the thread pool, leaving a single copy for the main thread.
+        if (packed && result != keytar::FAIL_ERROR) {
+                packedCredentials = keytar::PackCredentials(credentials);
+                credentials.clear();
+        }
 }
 
-void FindCredentialsWorker::HandleOKCallback() {
-        Nan::HandleScope scope;
-        if (success) {
-                v8::Local<v8::Array> val = Nan::New<v8::Array>(credentials.size());
-                unsigned int idx = 0;
-
-                std::vector<keytar::Credentials>::iterator it;
-                for (it = credentials.begin(); it != credentials.end(); it++) {
-                        keytar::Credentials cred = *it;
-                        v8::Local<v8::Object> obj = Nan::New<v8::Object>();
-
-                        v8::Local<v8::String> server = Nan::New<v8::String>(
-                                std::get<0>(cred).data(),
-                                std::get<0>(cred).length()).ToLocalChecked();
-
-                        v8::Local<v8::String> account = Nan::New<v8::String>(
-                                std::get<1>(cred).data(),
-                                std::get<1>(cred).length()).ToLocalChecked();
-
-                        obj->Set(Nan::New("server").ToLocalChecked(), server);
-                        obj->Set(Nan::New("account").ToLocalChecked(), account);
-                        // obj->Set(Nan::New("settings").ToLocalChecked(), std::get<2>(cred));
-
-                        std::vector<std::pair<std::string, const std::string > > settingsVector = std::get<2>(cred);
-                        std::vector<std::pair<std::string, const std::string > >::iterator s_it;
-                        v8::Local<v8::Object> settingObj = Nan::New<v8::Object>();
-                        for (s_it = settingsVector.begin(); s_it != settingsVector.end(); s_it++) {
-                                std::pair<std::string, const std::string > setting = *s_it;
-                                const std::string value = setting.second;
-                                v8::Local<v8::String> b = Nan::New<v8::String>(
-                                        value.data(),
-                                        value.length()).ToLocalChecked();
-
-
-                                settingObj->Set(Nan::New(std::string(setting.first)).ToLocalChecked(), b);
-                        }
-                        obj->Set(Nan::New("settings").ToLocalChecked(), settingObj);
-                        Nan::Set(val, idx, obj);
-                        ++idx;
+// Converts found credentials to an array of { server, account, settings }
+// objects.
+static v8::Local<v8::Array> ToCredentialsArray(
+        const std::vector<keytar::Credentials>& credentials) {
+        v8::Local<v8::Array> val = Nan::New<v8::Array>(credentials.size());
+        unsigned int idx = 0;
+
+        std::vector<keytar::Credentials>::const_iterator it;
+        for (it = credentials.begin(); it != credentials.end(); it++) {
+                keytar::Credentials cred = *it;
+                v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+                v8::Local<v8::String> server = Nan::New<v8::String>(
+                        std::get<0>(cred).data(),
+                        std::get<0>(cred).length()).ToLocalChecked();
+
+                v8::Local<v8::String> account = Nan::New<v8::String>(
+                        std::get<1>(cred).data(),
+                        std::get<1>(cred).length()).ToLocalChecked();
+
+                obj->Set(Nan::New("server").ToLocalChecked(), server);
+                obj->Set(Nan::New("account").ToLocalChecked(), account);
+                // obj->Set(Nan::New("settings").ToLocalChecked(), std::get<2>(cred));
+
+                std::vector<std::pair<std::string, const std::string > > settingsVector = std::get<2>(cred);
+                std::vector<std::pair<std::string, const std::string > >::iterator s_it;
+                v8::Local<v8::Object> settingObj = Nan::New<v8::Object>();
+                for (s_it = settingsVector.begin(); s_it != settingsVector.end(); s_it++) {
+                        std::pair<std::string, const std::string > setting = *s_it;
+                        const std::string value = setting.second;
+                        v8::Local<v8::String> b = Nan::New<v8::String>(
+                                value.data(),
+                                value.length()).ToLocalChecked();
+
+
+                        settingObj->Set(Nan::New(std::string(setting.first)).ToLocalChecked(), b);
                 }
+                obj->Set(Nan::New("settings").ToLocalChecked(), settingObj);
+                Nan::Set(val, idx, obj);
+                ++idx;
+        }
+        return val;
+}
 
+void FindCredentialsWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        if (packed) {
+                v8::Local<v8::Value> argv[] = {
+                        Nan::Null(),
+                        Nan::CopyBuffer(packedCredentials.data(),
+                                        packedCredentials.length()).ToLocalChecked()
+                };
+                callback->Call(2, argv);
+        } else if (success) {
                 v8::Local<v8::Value> argv[] = {
                         Nan::Null(),
-                        val
+                        ToCredentialsArray(credentials)
                 };
                 callback->Call(2, argv);
         } else {
@@ -237,3 +468,602 @@ void FindCredentialsWorker::HandleOKCallback() {
                 callback->Call(2, argv);
         }
 }
+
+
+
+FindCredentialsSinceWorker::FindCredentialsSinceWorker(
+        const std::string& service,
+        int64_t modifiedSince,
+        Nan::Callback* callback
+        ) : KeytarWorker("find_credentials_since", callback),
+        service(service),
+        modifiedSince(modifiedSince),
+        latest(modifiedSince) {
+}
+
+FindCredentialsSinceWorker::~FindCredentialsSinceWorker() {
+}
+
+void FindCredentialsSinceWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::FindCredentialsSince(service,
+                                                               modifiedSince,
+                                                               &changed,
+                                                               &accounts,
+                                                               &latest,
+                                                               &error);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void FindCredentialsSinceWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Array> accountsVal = Nan::New<v8::Array>(accounts.size());
+        for (size_t i = 0; i < accounts.size(); ++i) {
+                Nan::Set(accountsVal, i, Nan::New<v8::String>(
+                        accounts[i].data(),
+                        accounts[i].length()).ToLocalChecked());
+        }
+
+        v8::Local<v8::Object> val = Nan::New<v8::Object>();
+        Nan::Set(val, Nan::New("credentials").ToLocalChecked(),
+                 ToCredentialsArray(changed));
+        Nan::Set(val, Nan::New("accounts").ToLocalChecked(), accountsVal);
+        Nan::Set(val, Nan::New("latest").ToLocalChecked(),
+                 Nan::New<v8::Number>(static_cast<double>(latest)));
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+        callback->Call(2, argv);
+}
+
+
+
+SetLargePasswordWorker::SetLargePasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        const std::string& password,
+        size_t compressThreshold,
+        Nan::Callback* callback
+        ) : KeytarWorker("set_large_password", callback),
+        service(service),
+        account(account),
+        password(password),
+        compressThreshold(compressThreshold) {
+}
+
+SetLargePasswordWorker::~SetLargePasswordWorker() {
+}
+
+void SetLargePasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::SetLargePassword(service,
+                                                           account,
+                                                           password,
+                                                           compressThreshold,
+                                                           &error);
+        keytar::InvalidatePreloaded(service, account);
+        keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+
+
+GetLargePasswordWorker::GetLargePasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        Nan::Callback* callback,
+        bool binary
+        ) : KeytarWorker("get_large_password", callback),
+        service(service),
+        account(account),
+        binary(binary) {
+}
+
+GetLargePasswordWorker::~GetLargePasswordWorker() {
+}
+
+void GetLargePasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::GetLargePassword(service,
+                                                           account,
+                                                           &password,
+                                                           &error);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        } else if (result == keytar::FAIL_NONFATAL) {
+                success = false;
+        } else {
+                success = true;
+        }
+}
+
+void GetLargePasswordWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> val = Nan::Null();
+        if (success && binary) {
+                val = Nan::CopyBuffer(password.data(),
+                                      password.length()).ToLocalChecked();
+        } else if (success) {
+                val = Nan::New<v8::String>(password.data(),
+                                           password.length()).ToLocalChecked();
+        }
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+DeleteLargePasswordWorker::DeleteLargePasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        Nan::Callback* callback
+        ) : KeytarWorker("delete_large_password", callback),
+        service(service),
+        account(account) {
+}
+
+DeleteLargePasswordWorker::~DeleteLargePasswordWorker() {
+}
+
+void DeleteLargePasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::DeleteLargePassword(service,
+                                                              account,
+                                                              &error);
+        keytar::InvalidatePreloaded(service, account);
+        keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        } else if (result == keytar::FAIL_NONFATAL) {
+                success = false;
+        } else {
+                success = true;
+        }
+}
+
+void DeleteLargePasswordWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Boolean> val =
+                Nan::New<v8::Boolean>(success);
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+ConditionalSetPasswordWorker::ConditionalSetPasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        const std::string& password,
+        bool binary,
+        bool ifChanged,
+        bool hasExpected,
+        const std::string& expected,
+        Nan::Callback* callback
+        ) : KeytarWorker("conditional_set_password", callback),
+        service(service),
+        account(account),
+        password(password),
+        binary(binary),
+        ifChanged(ifChanged),
+        hasExpected(hasExpected),
+        expected(expected) {
+}
+
+ConditionalSetPasswordWorker::~ConditionalSetPasswordWorker() {
+}
+
+void ConditionalSetPasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result;
+        if (ifChanged) {
+                result = keytar::SetPasswordIfChanged(service,
+                                                      account,
+                                                      password,
+                                                      binary,
+                                                      &written,
+                                                      &error);
+        } else {
+                result = keytar::CompareAndSetPassword(service,
+                                                       account,
+                                                       hasExpected ? &expected : NULL,
+                                                       password,
+                                                       binary,
+                                                       &error);
+                written = result == keytar::SUCCESS;
+        }
+        keytar::InvalidatePreloaded(service, account);
+        if (written)
+                keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void ConditionalSetPasswordWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                Nan::New<v8::Boolean>(written)
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+// Returns the secret as a Buffer for binary workers, otherwise as a string.
+static v8::Local<v8::Value> ToSecretValue(const std::string& value, bool binary) {
+        if (binary) {
+                return Nan::CopyBuffer(value.data(),
+                                       value.length()).ToLocalChecked();
+        }
+        return Nan::New<v8::String>(value.data(),
+                                    value.length()).ToLocalChecked();
+}
+
+GetOrSetPasswordWorker::GetOrSetPasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        const std::string& generated,
+        bool binary,
+        Nan::Callback* callback
+        ) : KeytarWorker("get_or_set_password", callback),
+        service(service),
+        account(account),
+        generated(generated),
+        binary(binary),
+        created(false) {
+}
+
+GetOrSetPasswordWorker::~GetOrSetPasswordWorker() {
+}
+
+void GetOrSetPasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::GetOrSetPassword(service,
+                                                           account,
+                                                           generated,
+                                                           binary,
+                                                           &password,
+                                                           &created,
+                                                           &error);
+        keytar::InvalidatePreloaded(service, account);
+        if (created)
+                keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void GetOrSetPasswordWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                ToSecretValue(password, binary),
+                Nan::New<v8::Boolean>(created)
+        };
+
+        callback->Call(3, argv);
+}
+
+
+
+ReplacePasswordWorker::ReplacePasswordWorker(
+        const std::string& service,
+        const std::string& account,
+        const std::string& password,
+        bool binary,
+        Nan::Callback* callback
+        ) : KeytarWorker("replace_password", callback),
+        service(service),
+        account(account),
+        password(password),
+        binary(binary),
+        hadPrevious(false) {
+}
+
+ReplacePasswordWorker::~ReplacePasswordWorker() {
+}
+
+void ReplacePasswordWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::ReplacePassword(service,
+                                                          account,
+                                                          password,
+                                                          binary,
+                                                          &previous,
+                                                          &hadPrevious,
+                                                          &error);
+        keytar::InvalidatePreloaded(service, account);
+        if (result == keytar::SUCCESS)
+                keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void ReplacePasswordWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> val = Nan::Null();
+        if (hadPrevious) {
+                val = ToSecretValue(previous, binary);
+        }
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+DeleteCredentialsWorker::DeleteCredentialsWorker(
+        const std::string& service,
+        Nan::Callback* callback
+        ) : KeytarWorker("delete_credentials", callback),
+        service(service),
+        count(0) {
+}
+
+DeleteCredentialsWorker::~DeleteCredentialsWorker() {
+}
+
+void DeleteCredentialsWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = keytar::DeleteCredentials(service,
+                                                            &count,
+                                                            &error);
+        // Entries deleted before a failure are gone too.
+        keytar::InvalidatePreloaded(service);
+        keytar::agent::Invalidate(service);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void DeleteCredentialsWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                Nan::New<v8::Number>(static_cast<double>(count))
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+ExportToFdWorker::ExportToFdWorker(
+        const std::string& service,
+        const std::string& account,
+        Nan::Callback* callback
+        ) : KeytarWorker("export_to_fd", callback),
+        service(service),
+        account(account),
+        fd(-1) {
+}
+
+ExportToFdWorker::~ExportToFdWorker() {
+}
+
+void ExportToFdWorker::Run() {
+        std::string error;
+        std::string secret;
+        bool found;
+        KEYTAR_OP_RESULT result;
+        if (keytar::LookupPreloaded(service, account, true, &secret, &found)) {
+                result = found ? keytar::SUCCESS : keytar::FAIL_NONFATAL;
+        } else if (keytar::agent::GetPassword(service, account, true, &secret,
+                                              &result, &error)) {
+                // Served by keytar-agent.
+        } else {
+                result = keytar::GetPasswordBinary(service,
+                                                   account,
+                                                   &secret,
+                                                   &error);
+        }
+
+        if (result == keytar::SUCCESS) {
+                bool secretMemory;
+                result = keytar::CreateSecretFd(secret, &fd, &secretMemory, &error);
+        }
+        if (!secret.empty()) {
+                OPENSSL_cleanse(&secret[0], secret.size());
+        }
+
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void ExportToFdWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> val = Nan::Null();
+        if (fd >= 0) {
+                val = Nan::New<v8::Number>(fd);
+        }
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+UnlockWorker::UnlockWorker(
+        const std::vector<std::string>& collections,
+        Nan::Callback* callback
+        ) : KeytarWorker("unlock", callback),
+        collections(collections) {
+}
+
+UnlockWorker::~UnlockWorker() {
+}
+
+void UnlockWorker::Run() {
+        std::string error;
+        status = keytar::Unlock(collections, &error);
+        if (status == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void UnlockWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                Nan::New<v8::Boolean>(status == keytar::SUCCESS)
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+ReleaseWorker::ReleaseWorker(
+        Nan::Callback* callback
+        ) : KeytarWorker("release", callback) {
+}
+
+ReleaseWorker::~ReleaseWorker() {
+}
+
+void ReleaseWorker::Run() {
+        keytar::ReleaseConnection();
+        keytar::agent::CloseIdleConnections();
+}
+
+
+
+PreloadWorker::PreloadWorker(
+        const std::vector<std::string>& services,
+        Nan::Callback* callback
+        ) : KeytarWorker("preload", callback),
+        services(services),
+        count(0) {
+}
+
+PreloadWorker::~PreloadWorker() {
+}
+
+void PreloadWorker::Run() {
+        std::string error;
+        for (size_t i = 0; i < services.size(); ++i) {
+                size_t loaded = 0;
+                status = keytar::Preload(services[i], &loaded, &error);
+                if (status == keytar::FAIL_ERROR) {
+                        SetErrorMessage((services[i] + ": " + error).c_str());
+                        return;
+                }
+                count += loaded;
+        }
+}
+
+void PreloadWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                Nan::New<v8::Number>(static_cast<double>(count))
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+ExportNextWorker::ExportNextWorker(
+        keytar::Exporter* exporter,
+        size_t batchSize,
+        Nan::Callback* callback
+        ) : KeytarWorker("export_next", callback),
+        exporter(exporter),
+        batchSize(batchSize),
+        done(false) {
+}
+
+ExportNextWorker::~ExportNextWorker() {
+}
+
+void ExportNextWorker::Run() {
+        std::string error;
+        KEYTAR_OP_RESULT result = exporter->Next(batchSize, &records, &error);
+        status = result;
+        if (result == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        } else {
+                done = result == keytar::FAIL_NONFATAL;
+        }
+}
+
+void ExportNextWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> val = Nan::Null();
+        if (!done) {
+                val = Nan::CopyBuffer(records.data(),
+                                      records.length()).ToLocalChecked();
+        }
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                val
+        };
+
+        callback->Call(2, argv);
+}
+
+
+
+ImportWriteWorker::ImportWriteWorker(
+        keytar::Importer* importer,
+        const std::string& data,
+        Nan::Callback* callback
+        ) : KeytarWorker("import_write", callback),
+        importer(importer),
+        data(data) {
+}
+
+ImportWriteWorker::~ImportWriteWorker() {
+}
+
+void ImportWriteWorker::Run() {
+        std::string error;
+        status = importer->Write(data, &error);
+        if (status == keytar::FAIL_ERROR) {
+                SetErrorMessage(error.c_str());
+        }
+}
+
+void ImportWriteWorker::HandleOKCallback() {
+        Nan::HandleScope scope;
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(),
+                Nan::New<v8::Number>(static_cast<double>(importer->count()))
+        };
+
+        callback->Call(2, argv);
+}
@@ -1,85 +1,381 @@
 #ifndef SRC_ASYNC_H_
 #define SRC_ASYNC_H_
 
+#include <stdint.h>
+
+#include <memory>
 #include <string>
+#include <vector>
 #include "nan.h"
 
 #include "credentials.h"
+#include "transfer.h"
+
+// A service and account, converted to UTF-8 once and shared by a
+// CredentialHandle with the workers it queues, so that repeated calls on
+// the same entry don't convert or copy them again.
+struct CredentialKey {
+  CredentialKey(const std::string& service, const std::string& account)
+    : service(service), account(account) {}
+
+  const std::string service;
+  const std::string account;
+};
+
+// Calls `callback` right away with a value served by the preload cache, or
+// null when the cache knows there is no such entry.
+void CallWithPreloaded(v8::Local<v8::Value> callback,
+                       bool found,
+                       const std::string& password,
+                       bool binary);
+
+// Base of the workers below. Names the operation for the probes in
+// probes.h and fires them when the worker is queued, around Run() on the
+// thread pool and around the callback.
+class KeytarWorker : public Nan::AsyncWorker {
+  public:
+    KeytarWorker(const char* operation, Nan::Callback* callback);
+
+    // Queues the worker on the libuv thread pool.
+    void Queue();
+
+    void Execute();
+    void WorkComplete();
+    // Like Nan's, but errors caused by disabled prompts carry
+    // code = 'ERR_KEYTAR_LOCKED'.
+    void HandleErrorCallback();
 
-class SetPasswordWorker : public Nan::AsyncWorker {
+  protected:
+    // Does the work of Execute(). Sets `status` to the KEYTAR_OP_RESULT of
+    // the operation.
+    virtual void Run() = 0;
+
+    const char* const operation;
+    int status;
+};
+
+class SetPasswordWorker : public KeytarWorker {
   public:
+    // A `timeout` of -1 keeps the key timeout the backend was configured
+    // with; otherwise the key expires that many seconds after the write.
     SetPasswordWorker(const std::string& service, const std::string& account, const std::string& password,
-                      Nan::Callback* callback);
+                      Nan::Callback* callback, bool binary = false,
+                      const std::string& collection = std::string(),
+                      int64_t timeout = -1);
+    SetPasswordWorker(const std::shared_ptr<const CredentialKey>& key, const std::string& password,
+                      Nan::Callback* callback, bool binary);
 
     ~SetPasswordWorker();
 
-    void Execute();
+    void Run();
 
   private:
-    const std::string service;
-    const std::string account;
+    const std::shared_ptr<const CredentialKey> key;
+    const std::string& service;
+    const std::string& account;
     const std::string password;
+    const bool binary;
+    const std::string collection;
+    const int64_t timeout;
 };
 
-class GetPasswordWorker : public Nan::AsyncWorker {
+class GetPasswordWorker : public KeytarWorker {
   public:
-    GetPasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback);
+    GetPasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback,
+                      bool binary = false, const std::string& collection = std::string());
+    GetPasswordWorker(const std::shared_ptr<const CredentialKey>& key, Nan::Callback* callback, bool binary);
 
     ~GetPasswordWorker();
 
-    void Execute();
+    void Run();
     void HandleOKCallback();
 
   private:
-    const std::string service;
-    const std::string account;
+    const std::shared_ptr<const CredentialKey> key;
+    const std::string& service;
+    const std::string& account;
+    const bool binary;
+    const std::string collection;
     std::string password;
     bool success;
 };
 
-class DeletePasswordWorker : public Nan::AsyncWorker {
+class DeletePasswordWorker : public KeytarWorker {
   public:
-    DeletePasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback);
+    DeletePasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback,
+                         const std::string& collection = std::string());
+    DeletePasswordWorker(const std::shared_ptr<const CredentialKey>& key, Nan::Callback* callback);
 
     ~DeletePasswordWorker();
 
-    void Execute();
+    void Run();
     void HandleOKCallback();
 
   private:
-    const std::string service;
-    const std::string account;
+    const std::shared_ptr<const CredentialKey> key;
+    const std::string& service;
+    const std::string& account;
+    const std::string collection;
     bool success;
 };
 
-class FindPasswordWorker : public Nan::AsyncWorker {
+class FindPasswordWorker : public KeytarWorker {
   public:
-    FindPasswordWorker(const std::string& service, Nan::Callback* callback);
+    FindPasswordWorker(const std::string& service, Nan::Callback* callback,
+                       const std::string& collection = std::string());
 
     ~FindPasswordWorker();
 
-    void Execute();
+    void Run();
     void HandleOKCallback();
 
   private:
     const std::string service;
+    const std::string collection;
     std::string password;
     bool success;
 };
 
-class FindCredentialsWorker : public Nan::AsyncWorker {
+class FindCredentialsWorker : public KeytarWorker {
   public:
-    FindCredentialsWorker(const std::string& service, Nan::Callback* callback);
+    FindCredentialsWorker(const std::string& service, Nan::Callback* callback,
+                          const std::vector<std::string>& collections = std::vector<std::string>(),
+                          bool packed = false);
 
     ~FindCredentialsWorker();
 
-    void Execute();
+    void Run();
     void HandleOKCallback();
 
   private:
     const std::string service;
+    const std::vector<std::string> collections;
+    const bool packed;
     std::vector<keytar::Credentials> credentials;
+    std::string packedCredentials;
+    bool success;
+};
+
+class FindCredentialsSinceWorker : public KeytarWorker {
+  public:
+    FindCredentialsSinceWorker(const std::string& service, int64_t modifiedSince,
+                               Nan::Callback* callback);
+
+    ~FindCredentialsSinceWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const int64_t modifiedSince;
+    std::vector<keytar::Credentials> changed;
+    std::vector<std::string> accounts;
+    int64_t latest;
+};
+
+class SetLargePasswordWorker : public KeytarWorker {
+  public:
+    SetLargePasswordWorker(const std::string& service, const std::string& account, const std::string& password,
+                           size_t compressThreshold, Nan::Callback* callback);
+
+    ~SetLargePasswordWorker();
+
+    void Run();
+
+  private:
+    const std::string service;
+    const std::string account;
+    const std::string password;
+    const size_t compressThreshold;
+};
+
+class GetLargePasswordWorker : public KeytarWorker {
+  public:
+    GetLargePasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback,
+                           bool binary);
+
+    ~GetLargePasswordWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    const bool binary;
+    std::string password;
     bool success;
 };
 
+class DeleteLargePasswordWorker : public KeytarWorker {
+  public:
+    DeleteLargePasswordWorker(const std::string& service, const std::string& account, Nan::Callback* callback);
+
+    ~DeleteLargePasswordWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    bool success;
+};
+
+class ConditionalSetPasswordWorker : public KeytarWorker {
+  public:
+    ConditionalSetPasswordWorker(const std::string& service, const std::string& account, const std::string& password,
+                                 bool binary, bool ifChanged, bool hasExpected, const std::string& expected,
+                                 Nan::Callback* callback);
+
+    ~ConditionalSetPasswordWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    const std::string password;
+    const bool binary;
+    const bool ifChanged;
+    const bool hasExpected;
+    const std::string expected;
+    bool written;
+};
+
+class GetOrSetPasswordWorker : public KeytarWorker {
+  public:
+    GetOrSetPasswordWorker(const std::string& service, const std::string& account, const std::string& generated,
+                           bool binary, Nan::Callback* callback);
+
+    ~GetOrSetPasswordWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    const std::string generated;
+    const bool binary;
+    std::string password;
+    bool created;
+};
+
+class ReplacePasswordWorker : public KeytarWorker {
+  public:
+    ReplacePasswordWorker(const std::string& service, const std::string& account, const std::string& password,
+                          bool binary, Nan::Callback* callback);
+
+    ~ReplacePasswordWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    const std::string password;
+    const bool binary;
+    std::string previous;
+    bool hadPrevious;
+};
+
+class DeleteCredentialsWorker : public KeytarWorker {
+  public:
+    DeleteCredentialsWorker(const std::string& service, Nan::Callback* callback);
+
+    ~DeleteCredentialsWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    size_t count;
+};
+
+class ExportToFdWorker : public KeytarWorker {
+  public:
+    ExportToFdWorker(const std::string& service, const std::string& account, Nan::Callback* callback);
+
+    ~ExportToFdWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::string service;
+    const std::string account;
+    int fd;
+};
+
+class UnlockWorker : public KeytarWorker {
+  public:
+    UnlockWorker(const std::vector<std::string>& collections, Nan::Callback* callback);
+
+    ~UnlockWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::vector<std::string> collections;
+};
+
+class ReleaseWorker : public KeytarWorker {
+  public:
+    explicit ReleaseWorker(Nan::Callback* callback);
+
+    ~ReleaseWorker();
+
+    void Run();
+};
+
+class PreloadWorker : public KeytarWorker {
+  public:
+    PreloadWorker(const std::vector<std::string>& services, Nan::Callback* callback);
+
+    ~PreloadWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    const std::vector<std::string> services;
+    size_t count;
+};
+
+class ExportNextWorker : public KeytarWorker {
+  public:
+    ExportNextWorker(keytar::Exporter* exporter, size_t batchSize, Nan::Callback* callback);
+
+    ~ExportNextWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    keytar::Exporter* const exporter;
+    const size_t batchSize;
+    std::string records;
+    bool done;
+};
+
+class ImportWriteWorker : public KeytarWorker {
+  public:
+    ImportWriteWorker(keytar::Importer* importer, const std::string& data, Nan::Callback* callback);
+
+    ~ImportWriteWorker();
+
+    void Run();
+    void HandleOKCallback();
+
+  private:
+    keytar::Importer* const importer;
+    std::string data;
+};
+
 #endif  // SRC_ASYNC_H_
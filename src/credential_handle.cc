@@ -0,0 +1,77 @@
+#include "credential_handle.h"
+
+#include <string>
+
+#include "preload.h"
+
+CredentialHandle::CredentialHandle(const std::string& service,
+                                   const std::string& account)
+  : key(std::make_shared<CredentialKey>(service, account)) {
+}
+
+CredentialHandle::~CredentialHandle() {
+}
+
+void CredentialHandle::Init(v8::Local<v8::Object> exports) {
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("CredentialHandle").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Nan::SetPrototypeMethod(tpl, "get", Get);
+  Nan::SetPrototypeMethod(tpl, "set", Set);
+  Nan::SetPrototypeMethod(tpl, "delete", Delete);
+  Nan::Set(exports,
+           Nan::New("CredentialHandle").ToLocalChecked(),
+           Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+NAN_METHOD(CredentialHandle::New) {
+  CredentialHandle* handle = new CredentialHandle(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]));
+  handle->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+// get(binary, callback)
+NAN_METHOD(CredentialHandle::Get) {
+  CredentialHandle* handle =
+    Nan::ObjectWrap::Unwrap<CredentialHandle>(info.Holder());
+  bool binary = Nan::To<bool>(info[0]).FromJust();
+  std::string password;
+  bool found;
+  if (keytar::LookupPreloaded(handle->key->service, handle->key->account,
+                              binary, &password, &found)) {
+    CallWithPreloaded(info[1], found, password, binary);
+    return;
+  }
+
+  GetPasswordWorker* worker = new GetPasswordWorker(
+    handle->key,
+    new Nan::Callback(info[1].As<v8::Function>()),
+    binary);
+  worker->Queue();
+}
+
+// set(password, callback), where a Buffer password is stored as binary.
+NAN_METHOD(CredentialHandle::Set) {
+  CredentialHandle* handle =
+    Nan::ObjectWrap::Unwrap<CredentialHandle>(info.Holder());
+  bool binary = node::Buffer::HasInstance(info[0]);
+  SetPasswordWorker* worker = new SetPasswordWorker(
+    handle->key,
+    binary ? std::string(node::Buffer::Data(info[0]),
+                         node::Buffer::Length(info[0]))
+           : std::string(*v8::String::Utf8Value(info[0])),
+    new Nan::Callback(info[1].As<v8::Function>()),
+    binary);
+  worker->Queue();
+}
+
+NAN_METHOD(CredentialHandle::Delete) {
+  CredentialHandle* handle =
+    Nan::ObjectWrap::Unwrap<CredentialHandle>(info.Holder());
+  DeletePasswordWorker* worker = new DeletePasswordWorker(
+    handle->key,
+    new Nan::Callback(info[0].As<v8::Function>()));
+  worker->Queue();
+}
@@ -0,0 +1,29 @@
+#ifndef SRC_CREDENTIAL_HANDLE_H_
+#define SRC_CREDENTIAL_HANDLE_H_
+
+#include <memory>
+
+#include "nan.h"
+#include "async.h"
+
+// JS handle for one service and account, returned by keytar.handle(). The
+// strings are converted once when it is created and shared with every
+// worker it queues, so each call only converts its own arguments.
+
+class CredentialHandle : public Nan::ObjectWrap {
+  public:
+    static void Init(v8::Local<v8::Object> exports);
+
+  private:
+    CredentialHandle(const std::string& service, const std::string& account);
+    ~CredentialHandle();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Get);
+    static NAN_METHOD(Set);
+    static NAN_METHOD(Delete);
+
+    const std::shared_ptr<const CredentialKey> key;
+};
+
+#endif  // SRC_CREDENTIAL_HANDLE_H_
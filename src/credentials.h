@@ -2,7 +2,9 @@
 #define SRC_CREDENTIALS_H_
 
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 namespace keytar {
 
@@ -24,6 +24,42 @@ KEYTAR_OP_RESULT GetPassword(const std::string& service,
                              std::string* password,
                              std::string* error);
 
+// Binary variants store and return the secret bytes verbatim, without
+// treating them as UTF-8 text.
+KEYTAR_OP_RESULT SetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   const std::string& data,
+                                   std::string* error);
+
+KEYTAR_OP_RESULT GetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   std::string* data,
+                                   std::string* error);
+
+// SetPassword or SetPasswordBinary, with the key expiring `timeout` seconds
+// after the write (0 keeps it) instead of after the timeout the backend was
+// configured with. Only the keyctl backend expires keys; elsewhere this fails
+// with FAIL_ERROR.
+KEYTAR_OP_RESULT SetPasswordWithTimeout(const std::string& service,
+                                        const std::string& account,
+                                        const std::string& password,
+                                        bool binary,
+                                        unsigned int timeout,
+                                        std::string* error);
+
+// Reads the entry into `previous` and writes `password` over it, reusing
+// the item the read found where the backend allows it instead of searching
+// for the entry again. With `onlyIfMissing` an existing entry is left as it
+// is. Returns SUCCESS when the entry existed and FAIL_NONFATAL when
+// `password` was stored as a new one.
+KEYTAR_OP_RESULT ExchangePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  bool binary,
+                                  bool onlyIfMissing,
+                                  std::string* previous,
+                                  std::string* error);
+
 KEYTAR_OP_RESULT DeletePassword(const std::string& service,
                                 const std::string& account,
                                 std::string* error);
@@ -32,10 +68,110 @@ KEYTAR_OP_RESULT FindPassword(const std::string& service,
                               std::string* password,
                               std::string* error);
 
+// Credentials carry "created" and "modified" settings holding milliseconds
+// since the Unix epoch where the backend records them. Windows only records
+// "modified".
 KEYTAR_OP_RESULT FindCredentials(const std::string& service,
                                  std::vector<Credentials>*,
                                  std::string* error);
 
+// Deletes every entry stored for `service` using the items found by a
+// single search. Returns FAIL_NONFATAL when there was nothing to delete.
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* error);
+
+// An entry returned by FindSecrets. `text` is false when the backend knows
+// the secret was stored through the binary API.
+struct StoredSecret {
+  std::string account;
+  std::string secret;
+  bool text;
+};
+
+// Fetches the account and secret of every entry stored for `service` with
+// a single search where the backend allows it.
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* error);
+
+// Variants operating on one collection, named by alias, label or D-Bus
+// object path, instead of the default one. Only the libsecret backend has
+// collections; the others fail with FAIL_ERROR. Credentials found in a
+// collection carry its name in a "collection" setting.
+KEYTAR_OP_RESULT SetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         const std::string& password,
+                                         bool binary,
+                                         std::string* error);
+
+KEYTAR_OP_RESULT GetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         bool binary,
+                                         std::string* password,
+                                         std::string* error);
+
+KEYTAR_OP_RESULT DeletePasswordInCollection(const std::string& collection,
+                                            const std::string& service,
+                                            const std::string& account,
+                                            std::string* error);
+
+KEYTAR_OP_RESULT FindPasswordInCollection(const std::string& collection,
+                                          const std::string& service,
+                                          std::string* password,
+                                          std::string* error);
+
+KEYTAR_OP_RESULT FindCredentialsInCollection(const std::string& collection,
+                                             const std::string& service,
+                                             std::vector<Credentials>*,
+                                             std::string* error);
+
+// Selects where secrets are stored. `name` is "default" for the platform's
+// keychain; on Linux it may also be "keyctl" for the kernel key retention
+// service (see keytar_keyctl.h), which takes a `keyring` ("user", the
+// default, "session" or "process") and a `timeout` in seconds after which
+// stored keys expire, or 0 to keep them.
+struct BackendOptions {
+  BackendOptions() : timeout(0) {}
+
+  std::string name;
+  std::string keyring;
+  unsigned int timeout;
+};
+
+// Applies to every call above for the rest of the process.
+KEYTAR_OP_RESULT ConfigureBackend(const BackendOptions& options,
+                                  std::string* error);
+
+// Closes the connection to the keyring service, and frees what was cached
+// for it, once no call has been made for `milliseconds`. 0 (the default)
+// keeps it open. The next call connects again. Only the libsecret backend
+// keeps a connection; elsewhere these do nothing.
+void SetIdleTimeout(unsigned int milliseconds);
+
+// Does the same now, once running calls have returned.
+void ReleaseConnection();
+
+// Whether calls may prompt the user to unlock the keychain or a collection
+// (true by default). When not, calls that would prompt fail right away with
+// FAIL_ERROR and kLockedError instead, so background work never waits on a
+// prompt. Applies to every thread.
+void SetInteractive(bool interactive);
+
+// The current value of the setting above.
+bool Interactive();
+
+// The error of calls that failed because prompts are disabled.
+extern const char kLockedError[];
+
+// Unlocks the named collections, or the default one when `collections` is
+// empty, with a single prompt, even when prompts are otherwise disabled.
+// Returns FAIL_NONFATAL when the user dismissed the prompt.
+KEYTAR_OP_RESULT Unlock(const std::vector<std::string>& collections,
+                        std::string* error);
+
 }  // namespace keytar
 
 #endif  // SRC_KEYTAR_H_
@@ -0,0 +1,438 @@
+#include "keytar_keyctl.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/keyctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace keytar {
+
+namespace keyctl {
+
+const char kCollectionsUnsupported[] =
+  "Collections are not supported by the keyctl backend";
+
+#ifdef __linux__
+
+namespace {
+
+typedef int32_t key_serial_t;
+
+const char kKeyType[] = "user";
+const char kPrefix[] = "keytar:";
+
+// Possessor and owner may view, read, write, search, link and set
+// attributes, so other processes of the user can reach keys in the user
+// keyring even when it isn't linked into their session keyring.
+const uint32_t kKeyPermissions = 0x3f3f0000;
+
+std::atomic<bool> enabled(false);
+std::atomic<key_serial_t> keyring(KEY_SPEC_USER_KEYRING);
+std::atomic<unsigned int> timeout(0);
+
+// Reads KEYTAR_BACKEND once, so the backend can be chosen without code
+// changes, for example for keytar-agent.
+struct EnvironmentDefault {
+  EnvironmentDefault() {
+    const char* backend = getenv("KEYTAR_BACKEND");
+    if (backend != NULL && strcmp(backend, "keyctl") == 0)
+      enabled = true;
+  }
+} environmentDefault;
+
+long KeyCtl(int operation, unsigned long a, unsigned long b = 0,
+            unsigned long c = 0, unsigned long d = 0) {
+  return syscall(SYS_keyctl, operation, a, b, c, d);
+}
+
+std::string Escape(const std::string& value) {
+  std::string escaped;
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '%')
+      escaped += "%25";
+    else if (value[i] == '/')
+      escaped += "%2F";
+    else
+      escaped += value[i];
+  }
+  return escaped;
+}
+
+std::string Unescape(const std::string& value) {
+  std::string unescaped;
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value.compare(i, 3, "%25") == 0) {
+      unescaped += '%';
+      i += 2;
+    } else if (value.compare(i, 3, "%2F") == 0) {
+      unescaped += '/';
+      i += 2;
+    } else {
+      unescaped += value[i];
+    }
+  }
+  return unescaped;
+}
+
+std::string ServicePrefix(const std::string& service) {
+  return kPrefix + Escape(service) + "/";
+}
+
+std::string Description(const std::string& service,
+                        const std::string& account) {
+  return ServicePrefix(service) + Escape(account);
+}
+
+const char kEmptyValue[] = "The keyctl backend cannot store empty values";
+const char kQuotaExceeded[] =
+  "The kernel key quota of this user is used up; see "
+  "/proc/sys/kernel/keys/maxbytes";
+
+KEYTAR_OP_RESULT SystemError(std::string* error) {
+  *error = strerror(errno);
+  return FAIL_ERROR;
+}
+
+bool IsMissing(int code) {
+  return code == ENOKEY || code == EKEYEXPIRED || code == EKEYREVOKED;
+}
+
+// Finds the key for `description` in the configured keyring or one linked
+// into it. Returns FAIL_NONFATAL when there is none.
+KEYTAR_OP_RESULT Search(const std::string& description,
+                        key_serial_t* key,
+                        std::string* error) {
+  long found = KeyCtl(KEYCTL_SEARCH,
+                      keyring.load(),
+                      reinterpret_cast<unsigned long>(kKeyType),
+                      reinterpret_cast<unsigned long>(description.c_str()));
+  if (found < 0)
+    return IsMissing(errno) ? FAIL_NONFATAL : SystemError(error);
+  *key = static_cast<key_serial_t>(found);
+  return SUCCESS;
+}
+
+// Reads the payload of `key`, or the serials linked into it for a keyring.
+KEYTAR_OP_RESULT Read(key_serial_t key, std::string* data, std::string* error) {
+  // The payload can change between the sizing call and the read, so retry
+  // until it fits.
+  long size = KeyCtl(KEYCTL_READ, key, 0, 0);
+  while (size >= 0) {
+    data->resize(size);
+    long read = KeyCtl(KEYCTL_READ, key,
+                       reinterpret_cast<unsigned long>(&(*data)[0]), size);
+    if (read >= 0 && read <= size) {
+      data->resize(read);
+      return SUCCESS;
+    }
+    size = read;
+  }
+  return IsMissing(errno) ? FAIL_NONFATAL : SystemError(error);
+}
+
+struct Entry {
+  key_serial_t key;
+  std::string account;
+};
+
+// Lists the keys of `service` linked directly into the configured keyring,
+// matching on the description prefix.
+KEYTAR_OP_RESULT List(const std::string& service,
+                      std::vector<Entry>* entries,
+                      std::string* error) {
+  std::string serials;
+  KEYTAR_OP_RESULT result = Read(keyring.load(), &serials, error);
+  if (result == FAIL_NONFATAL)
+    return SUCCESS;
+  if (result != SUCCESS)
+    return result;
+
+  const std::string prefix = ServicePrefix(service);
+  size_t count = serials.size() / sizeof(key_serial_t);
+  for (size_t i = 0; i < count; ++i) {
+    key_serial_t key;
+    memcpy(&key, serials.data() + i * sizeof(key), sizeof(key));
+
+    // "type;uid;gid;perm;description"
+    char buffer[4096];
+    long length = KeyCtl(KEYCTL_DESCRIBE, key,
+                         reinterpret_cast<unsigned long>(buffer),
+                         sizeof(buffer));
+    if (length < 0 || static_cast<size_t>(length) > sizeof(buffer))
+      continue;
+    std::string info(buffer, length > 0 ? length - 1 : 0);
+    size_t type = info.find(';');
+    if (info.compare(0, type, kKeyType) != 0)
+      continue;
+    size_t field = type;
+    for (int skip = 0; skip < 3 && field != std::string::npos; ++skip)
+      field = info.find(';', field + 1);
+    if (field == std::string::npos)
+      continue;
+    std::string description = info.substr(field + 1);
+    if (description.compare(0, prefix.size(), prefix) != 0)
+      continue;
+
+    Entry entry;
+    entry.key = key;
+    entry.account = Unescape(description.substr(prefix.size()));
+    entries->push_back(entry);
+  }
+  return SUCCESS;
+}
+
+}  // namespace
+
+bool Enabled() {
+  return enabled;
+}
+
+KEYTAR_OP_RESULT Configure(const BackendOptions& options, std::string* error) {
+  if (options.name != "keyctl") {
+    enabled = false;
+    return SUCCESS;
+  }
+
+  key_serial_t ring;
+  if (options.keyring.empty() || options.keyring == "user") {
+    ring = KEY_SPEC_USER_KEYRING;
+  } else if (options.keyring == "session") {
+    ring = KEY_SPEC_SESSION_KEYRING;
+  } else if (options.keyring == "process") {
+    ring = KEY_SPEC_PROCESS_KEYRING;
+  } else {
+    *error = "Unknown keyring: " + options.keyring;
+    return FAIL_ERROR;
+  }
+
+  // Create the keyring now, so that a kernel without key retention
+  // support is reported here rather than on first use.
+  if (KeyCtl(KEYCTL_GET_KEYRING_ID, ring, 1) < 0)
+    return SystemError(error);
+
+  keyring = ring;
+  timeout = options.timeout;
+  enabled = true;
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT SetPassword(const std::string& service,
+                             const std::string& account,
+                             const std::string& password,
+                             std::string* error) {
+  return SetPassword(service, account, password, timeout.load(), error);
+}
+
+KEYTAR_OP_RESULT SetPassword(const std::string& service,
+                             const std::string& account,
+                             const std::string& password,
+                             unsigned int seconds,
+                             std::string* error) {
+  // add_key only says EINVAL for these.
+  if (password.empty()) {
+    *error = kEmptyValue;
+    return FAIL_ERROR;
+  }
+  if (password.size() > kMaxPayloadSize) {
+    *error = "The keyctl backend stores values of at most " +
+             std::to_string(kMaxPayloadSize) + " bytes; use large-value "
+             "mode for bigger ones";
+    return FAIL_ERROR;
+  }
+
+  const std::string description = Description(service, account);
+  // Replaces the payload of an existing key with the same description.
+  long key = syscall(SYS_add_key, kKeyType, description.c_str(),
+                     password.data(), password.size(), keyring.load());
+  if (key < 0 && errno == EDQUOT) {
+    *error = kQuotaExceeded;
+    return FAIL_ERROR;
+  }
+  if (key < 0)
+    return SystemError(error);
+
+  if (KeyCtl(KEYCTL_SETPERM, key, kKeyPermissions) < 0)
+    return SystemError(error);
+  // Also clears the expiry of a replaced key when no timeout is set.
+  if (KeyCtl(KEYCTL_SET_TIMEOUT, key, seconds) < 0)
+    return SystemError(error);
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT GetPassword(const std::string& service,
+                             const std::string& account,
+                             std::string* password,
+                             std::string* error) {
+  key_serial_t key;
+  KEYTAR_OP_RESULT result = Search(Description(service, account), &key, error);
+  if (result != SUCCESS)
+    return result;
+  return Read(key, password, error);
+}
+
+KEYTAR_OP_RESULT DeletePassword(const std::string& service,
+                                const std::string& account,
+                                std::string* error) {
+  key_serial_t key;
+  KEYTAR_OP_RESULT result = Search(Description(service, account), &key, error);
+  if (result != SUCCESS)
+    return result;
+  if (KeyCtl(KEYCTL_INVALIDATE, key) < 0)
+    return IsMissing(errno) ? FAIL_NONFATAL : SystemError(error);
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT FindPassword(const std::string& service,
+                              std::string* password,
+                              std::string* error) {
+  std::vector<Entry> entries;
+  KEYTAR_OP_RESULT result = List(service, &entries, error);
+  if (result != SUCCESS)
+    return result;
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    result = Read(entries[i].key, password, error);
+    // Skip keys that expired since they were listed.
+    if (result != FAIL_NONFATAL)
+      return result;
+  }
+  return FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT FindCredentials(const std::string& service,
+                                 std::vector<Credentials>* credentials,
+                                 std::string* error) {
+  std::vector<Entry> entries;
+  KEYTAR_OP_RESULT result = List(service, &entries, error);
+  if (result != SUCCESS)
+    return result;
+
+  for (size_t i = 0; i < entries.size(); ++i)
+    credentials->push_back(Credentials(service, entries[i].account, {}));
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* error) {
+  std::vector<Entry> entries;
+  KEYTAR_OP_RESULT result = List(service, &entries, error);
+  if (result != SUCCESS)
+    return result;
+
+  *count = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (KeyCtl(KEYCTL_INVALIDATE, entries[i].key) == 0)
+      ++*count;
+    else if (!IsMissing(errno))
+      return SystemError(error);
+  }
+  return *count > 0 ? SUCCESS : FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* error) {
+  std::vector<Entry> entries;
+  KEYTAR_OP_RESULT result = List(service, &entries, error);
+  if (result != SUCCESS)
+    return result;
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    StoredSecret found;
+    found.account = entries[i].account;
+    found.text = true;
+    result = Read(entries[i].key, &found.secret, error);
+    if (result == FAIL_ERROR)
+      return FAIL_ERROR;
+    if (result == SUCCESS)
+      secrets->push_back(found);
+  }
+  return SUCCESS;
+}
+
+#else  // !__linux__
+
+namespace {
+
+const char kUnsupported[] = "The keyctl backend is only available on Linux";
+
+}  // namespace
+
+bool Enabled() {
+  return false;
+}
+
+KEYTAR_OP_RESULT Configure(const BackendOptions& options, std::string* error) {
+  if (options.name != "keyctl")
+    return SUCCESS;
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT SetPassword(const std::string& service,
+                             const std::string& account,
+                             const std::string& password,
+                             std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT GetPassword(const std::string& service,
+                             const std::string& account,
+                             std::string* password,
+                             std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT DeletePassword(const std::string& service,
+                                const std::string& account,
+                                std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindPassword(const std::string& service,
+                              std::string* password,
+                              std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindCredentials(const std::string& service,
+                                 std::vector<Credentials>* credentials,
+                                 std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+#endif  // __linux__
+
+}  // namespace keyctl
+
+}  // namespace keytar
@@ -0,0 +1,74 @@
+#ifndef SRC_KEYTAR_KEYCTL_H_
+#define SRC_KEYTAR_KEYCTL_H_
+
+#include <string>
+#include <vector>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// Backend on the Linux kernel key retention service. Secrets are "user"
+// keys described as "keytar:<service>/<account>", with '%' and '/' escaped
+// in both parts, and linked into one of the calling process's keyrings.
+// Every call is a few keyctl(2) system calls; no daemon is involved.
+// keytar_posix.cc forwards to it once it is selected with ConfigureBackend
+// or the KEYTAR_BACKEND=keyctl environment variable.
+namespace keyctl {
+
+// Whether the keytar:: calls go to this backend.
+bool Enabled();
+
+// Selects this backend (or the Secret Service again) for the process.
+KEYTAR_OP_RESULT Configure(const BackendOptions& options, std::string* error);
+
+KEYTAR_OP_RESULT SetPassword(const std::string& service,
+                             const std::string& account,
+                             const std::string& password,
+                             std::string* error);
+
+// Like SetPassword, with the key expiring after `seconds` (0 keeps
+// it) instead of after the configured timeout.
+KEYTAR_OP_RESULT SetPassword(const std::string& service,
+                             const std::string& account,
+                             const std::string& password,
+                             unsigned int seconds,
+                             std::string* error);
+
+KEYTAR_OP_RESULT GetPassword(const std::string& service,
+                             const std::string& account,
+                             std::string* password,
+                             std::string* error);
+
+KEYTAR_OP_RESULT DeletePassword(const std::string& service,
+                                const std::string& account,
+                                std::string* error);
+
+KEYTAR_OP_RESULT FindPassword(const std::string& service,
+                              std::string* password,
+                              std::string* error);
+
+KEYTAR_OP_RESULT FindCredentials(const std::string& service,
+                                 std::vector<Credentials>* credentials,
+                                 std::string* error);
+
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* error);
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* error);
+
+// Largest value the kernel accepts for a "user" key. It rejects empty
+// values too, and SetPassword fails on both with a message saying so.
+const size_t kMaxPayloadSize = 32767;
+
+// Returned by the collection calls, which this backend doesn't have.
+extern const char kCollectionsUnsupported[];
+
+}  // namespace keyctl
+
+}  // namespace keytar
+
+#endif  // SRC_KEYTAR_KEYCTL_H_
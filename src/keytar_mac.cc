@@ -39,7 +39,23 @@ const std::string CFStringToStdString(CFStringRef cfstring) {
         return stdstring;
 }
 
+/**
+ * Converts a CFDate to milliseconds since the Unix epoch, as a string
+ */
+const std::string CFDateToEpochMillis(CFDateRef date) {
+        CFAbsoluteTime seconds = CFDateGetAbsoluteTime(date) +
+                                 kCFAbsoluteTimeIntervalSince1970;
+        return std::to_string(static_cast<long long>(seconds * 1000));
+}
+
+const char kLockedError[] =
+        "The keychain is locked and user interaction is disabled";
+
 const std::string errorStatusToString(OSStatus status) {
+        if (status == errSecInteractionNotAllowed) {
+                return kLockedError;
+        }
+
         std::string errorStr;
         CFStringRef errorMessageString = SecCopyErrorMessageString(status, NULL);
 
@@ -140,6 +156,76 @@ KEYTAR_OP_RESULT GetPassword(const std::string& service,
         return SUCCESS;
 }
 
+KEYTAR_OP_RESULT SetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   const std::string& data,
+                                   std::string* error) {
+        // Keychain items hold raw bytes, so no conversion is needed.
+        return SetPassword(service, account, data, error);
+}
+
+KEYTAR_OP_RESULT GetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   std::string* data,
+                                   std::string* error) {
+        return GetPassword(service, account, data, error);
+}
+
+KEYTAR_OP_RESULT ExchangePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  bool binary,
+                                  bool onlyIfMissing,
+                                  std::string* previous,
+                                  std::string* error) {
+        void *data;
+        UInt32 length;
+        SecKeychainItemRef item;
+        OSStatus status = SecKeychainFindInternetPassword(NULL,
+                                                          service.length(),
+                                                          service.data(),
+                                                          0,
+                                                          NULL,
+                                                          account.length(),
+                                                          account.data(),
+                                                          0,
+                                                          NULL,
+                                                          0,
+                                                          kSecProtocolTypeAny,
+                                                          kSecAuthenticationTypeAny,
+                                                          &length,
+                                                          &data,
+                                                          &item);
+        if (status == errSecItemNotFound) {
+                // SetPassword tries to add first, so this doesn't search
+                // again unless another process added the item meanwhile.
+                KEYTAR_OP_RESULT result = SetPassword(service, account,
+                                                      password, error);
+                return result == SUCCESS ? FAIL_NONFATAL : result;
+        } else if (status != errSecSuccess) {
+                *error = errorStatusToString(status);
+                return FAIL_ERROR;
+        }
+
+        *previous = std::string(reinterpret_cast<const char*>(data), length);
+        SecKeychainItemFreeContent(NULL, data);
+
+        // Keychain items hold raw bytes, so `binary` makes no difference.
+        if (!onlyIfMissing) {
+                status = SecKeychainItemModifyAttributesAndData(item,
+                                                                NULL,
+                                                                password.length(),
+                                                                password.data());
+        }
+        CFRelease(item);
+        if (status != errSecSuccess) {
+                *error = errorStatusToString(status);
+                return FAIL_ERROR;
+        }
+
+        return SUCCESS;
+}
+
 KEYTAR_OP_RESULT DeletePassword(const std::string& service,
                                 const std::string& account,
                                 std::string* error) {
@@ -272,6 +358,16 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
                         if(protocol) {
                                 settings.push_back(std::make_pair<std::string, const std::string >("protocol", CFStringToStdString((CFStringRef) protocol)));
                         }
+                        CFTypeRef created = nil;
+                        CFDictionaryGetValueIfPresent(item, kSecAttrCreationDate, &created);
+                        if(created) {
+                                settings.push_back(std::make_pair<std::string, const std::string >("created", CFDateToEpochMillis((CFDateRef) created)));
+                        }
+                        CFTypeRef modified = nil;
+                        CFDictionaryGetValueIfPresent(item, kSecAttrModificationDate, &modified);
+                        if(modified) {
+                                settings.push_back(std::make_pair<std::string, const std::string >("modified", CFDateToEpochMillis((CFDateRef) modified)));
+                        }
                         Credentials cred = Credentials(
                                 CFStringToStdString(service),
                                 CFStringToStdString(account),
@@ -296,4 +392,236 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
         return SUCCESS;
 }
 
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* error) {
+        CFStringRef serviceStr = CFStringCreateWithCString(
+                NULL,
+                service.c_str(),
+                kCFStringEncodingUTF8);
+
+        CFMutableDictionaryRef query = CFDictionaryCreateMutable(
+                NULL,
+                0,
+                &kCFTypeDictionaryKeyCallBacks,
+                &kCFTypeDictionaryValueCallBacks);
+        CFDictionaryAddValue(query, kSecClass, kSecClassInternetPassword);
+        CFDictionaryAddValue(query, kSecAttrServer, serviceStr);
+        CFDictionaryAddValue(query, kSecMatchLimit, kSecMatchLimitAll);
+        CFDictionaryAddValue(query, kSecReturnRef, kCFBooleanTrue);
+
+        CFTypeRef result = NULL;
+        OSStatus status = SecItemCopyMatching((CFDictionaryRef) query, &result);
+        CFRelease(query);
+        CFRelease(serviceStr);
+
+        if (status == errSecItemNotFound) {
+                return FAIL_NONFATAL;
+        } else if (status != errSecSuccess) {
+                *error = errorStatusToString(status);
+                return FAIL_ERROR;
+        }
+
+        // Delete the matched items by reference instead of looking each
+        // one up again.
+        *count = 0;
+        CFArrayRef items = (CFArrayRef) result;
+        CFIndex itemCount = CFArrayGetCount(items);
+        for (CFIndex idx = 0; idx < itemCount; idx++) {
+                SecKeychainItemRef item =
+                        (SecKeychainItemRef) CFArrayGetValueAtIndex(items, idx);
+                status = SecKeychainItemDelete(item);
+                if (status != errSecSuccess) {
+                        *error = errorStatusToString(status);
+                        CFRelease(result);
+                        return FAIL_ERROR;
+                }
+                ++*count;
+        }
+
+        CFRelease(result);
+        return *count > 0 ? SUCCESS : FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* error) {
+        CFStringRef serviceStr = CFStringCreateWithCString(
+                NULL,
+                service.c_str(),
+                kCFStringEncodingUTF8);
+
+        // Returning data for several items in one query isn't supported by
+        // file-based keychains, so match references and read each item's
+        // content through them.
+        CFMutableDictionaryRef query = CFDictionaryCreateMutable(
+                NULL,
+                0,
+                &kCFTypeDictionaryKeyCallBacks,
+                &kCFTypeDictionaryValueCallBacks);
+        CFDictionaryAddValue(query, kSecClass, kSecClassInternetPassword);
+        CFDictionaryAddValue(query, kSecAttrServer, serviceStr);
+        CFDictionaryAddValue(query, kSecMatchLimit, kSecMatchLimitAll);
+        CFDictionaryAddValue(query, kSecReturnRef, kCFBooleanTrue);
+        CFDictionaryAddValue(query, kSecReturnAttributes, kCFBooleanTrue);
+
+        CFTypeRef result = NULL;
+        OSStatus status = SecItemCopyMatching((CFDictionaryRef) query, &result);
+        CFRelease(query);
+        CFRelease(serviceStr);
+
+        if (status == errSecItemNotFound) {
+                return SUCCESS;
+        } else if (status != errSecSuccess) {
+                *error = errorStatusToString(status);
+                return FAIL_ERROR;
+        }
+
+        CFArrayRef items = (CFArrayRef) result;
+        CFIndex itemCount = CFArrayGetCount(items);
+        for (CFIndex idx = 0; idx < itemCount; idx++) {
+                CFDictionaryRef item =
+                        (CFDictionaryRef) CFArrayGetValueAtIndex(items, idx);
+                CFStringRef account =
+                        (CFStringRef) CFDictionaryGetValue(item, kSecAttrAccount);
+                SecKeychainItemRef ref =
+                        (SecKeychainItemRef) CFDictionaryGetValue(item, kSecValueRef);
+                if (account == NULL || ref == NULL) {
+                        continue;
+                }
+
+                void* data = NULL;
+                UInt32 length = 0;
+                status = SecKeychainItemCopyContent(ref, NULL, NULL, &length, &data);
+                if (status != errSecSuccess) {
+                        *error = errorStatusToString(status);
+                        CFRelease(result);
+                        return FAIL_ERROR;
+                }
+
+                StoredSecret found;
+                found.account = CFStringToStdString(account);
+                found.secret = std::string(reinterpret_cast<const char*>(data), length);
+                found.text = true;
+                secrets->push_back(found);
+                SecKeychainItemFreeContent(NULL, data);
+        }
+
+        CFRelease(result);
+        return SUCCESS;
+}
+
+namespace {
+
+const char kCollectionsUnsupported[] =
+        "Collections are not supported on this platform";
+
+const char kKeyTimeoutsUnsupported[] =
+        "Key timeouts are not supported on this platform";
+
+}  // namespace
+
+KEYTAR_OP_RESULT SetPasswordWithTimeout(const std::string& service,
+                                        const std::string& account,
+                                        const std::string& password,
+                                        bool binary,
+                                        unsigned int timeout,
+                                        std::string* error) {
+        *error = kKeyTimeoutsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT SetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         const std::string& password,
+                                         bool binary,
+                                         std::string* error) {
+        *error = kCollectionsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT GetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         bool binary,
+                                         std::string* password,
+                                         std::string* error) {
+        *error = kCollectionsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT DeletePasswordInCollection(const std::string& collection,
+                                            const std::string& service,
+                                            const std::string& account,
+                                            std::string* error) {
+        *error = kCollectionsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindPasswordInCollection(const std::string& collection,
+                                          const std::string& service,
+                                          std::string* password,
+                                          std::string* error) {
+        *error = kCollectionsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindCredentialsInCollection(const std::string& collection,
+                                             const std::string& service,
+                                             std::vector<Credentials>* credentials,
+                                             std::string* error) {
+        *error = kCollectionsUnsupported;
+        return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT ConfigureBackend(const BackendOptions& options,
+                                  std::string* error) {
+        if (options.name == "default") {
+                return SUCCESS;
+        }
+        *error = "Backend not available on this platform: " + options.name;
+        return FAIL_ERROR;
+}
+
+void SetIdleTimeout(unsigned int milliseconds) {
+}
+
+void ReleaseConnection() {
+}
+
+void SetInteractive(bool interactive) {
+        // Process-wide in the Security framework, like the setting itself.
+        SecKeychainSetUserInteractionAllowed(interactive);
+}
+
+bool Interactive() {
+        Boolean allowed = true;
+        SecKeychainGetUserInteractionAllowed(&allowed);
+        return allowed;
+}
+
+KEYTAR_OP_RESULT Unlock(const std::vector<std::string>& collections,
+                        std::string* error) {
+        if (!collections.empty()) {
+                *error = kCollectionsUnsupported;
+                return FAIL_ERROR;
+        }
+
+        Boolean allowed = true;
+        SecKeychainGetUserInteractionAllowed(&allowed);
+        SecKeychainSetUserInteractionAllowed(true);
+        // Prompts for the default keychain's password when it is locked.
+        OSStatus status = SecKeychainUnlock(NULL, 0, NULL, false);
+        SecKeychainSetUserInteractionAllowed(allowed);
+
+        if (status == errSecAuthFailed || status == errSecUserCanceled) {
+                return FAIL_NONFATAL;
+        } else if (status != errSecSuccess) {
+                *error = errorStatusToString(status);
+                return FAIL_ERROR;
+        }
+        return SUCCESS;
+}
+
 }  // namespace keytar
@@ -1,14 +1,28 @@
 #include "keytar.h"
 
-// This is needed to make the builds on Ubuntu 14.04 / libsecret v0.16 work.
-// The API we use has already stabilized.
-#define SECRET_API_SUBJECT_TO_CHANGE
-#include <libsecret/secret.h>
+#include "keytar_keyctl.h"
+
+// libsecret and GLib calls in this file go through the lazily resolved
+// function pointers declared in libsecret_loader.h.
+#include "libsecret_loader.h"
+#include "probes.h"
+#include <malloc.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
 namespace keytar {
 
+const char kLockedError[] =
+  "The collection is locked and interactive unlocking is disabled";
+
 namespace {
 
 static const SecretSchema schema = {
@@ -18,12 +32,463 @@ static const SecretSchema schema = {
   }
 };
 
+// Content type used for secrets stored through the binary API, so that the
+// bytes are never interpreted as text by libsecret or the daemon.
+static const char kBinaryContentType[] = "application/octet-stream";
+
+const char kKeyTimeoutsUnsupported[] =
+  "Key timeouts are only supported by the keyctl backend";
+
+// The content type secret_password_store_sync gives text secrets.
+static const char kTextContentType[] = "text/plain";
+
+// Whether calls may make the Secret Service prompt to unlock a collection.
+// When not, calls that need a locked collection fail with kLockedError.
+std::atomic<bool> interactive(true);
+
+// `flags`, without SECRET_SEARCH_UNLOCK when prompts are disabled.
+SecretSearchFlags SearchFlags(int flags) {
+  if (!interactive)
+    flags &= ~SECRET_SEARCH_UNLOCK;
+  return static_cast<SecretSearchFlags>(flags);
+}
+
+// Whether any of `items` is still locked. Only the result of a search made
+// without SECRET_SEARCH_UNLOCK can hold locked items.
+bool AnyLocked(GList* items) {
+  for (GList* current = items; current != NULL; current = current->next) {
+    if (secret_item_get_locked(reinterpret_cast<SecretItem*>(current->data)))
+      return true;
+  }
+  return false;
+}
+
+KEYTAR_OP_RESULT Locked(std::string* errStr) {
+  *errStr = kLockedError;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT OpenCollection(const std::string& name,
+                                SecretCollection** collection,
+                                std::string* errStr);
+
+// Fails with kLockedError when prompts are disabled and the default
+// collection is locked, since storing into it or deleting from it would
+// prompt.
+KEYTAR_OP_RESULT CheckDefaultUnlocked(std::string* errStr) {
+  if (interactive)
+    return SUCCESS;
+  SecretCollection* collection = NULL;
+  if (OpenCollection("default", &collection, errStr) != SUCCESS)
+    return FAIL_ERROR;
+  bool locked = secret_collection_get_locked(collection);
+  g_object_unref(collection);
+  return locked ? Locked(errStr) : SUCCESS;
+}
+
+// Object paths of items seen by earlier lookups and enumerations, so that
+// repeated access can load or delete the item directly instead of running
+// SearchItems first. Entries may go stale when another process deletes or
+// recreates an item; callers then fall back to a search.
+typedef std::pair<std::string, std::string> ItemKey;
+std::mutex itemPathsLock;
+std::map<ItemKey, std::string> itemPaths;
+
+bool CachedItemPath(const std::string& service,
+                    const std::string& account,
+                    std::string* path) {
+  std::lock_guard<std::mutex> lock(itemPathsLock);
+  std::map<ItemKey, std::string>::const_iterator it =
+    itemPaths.find(ItemKey(service, account));
+  if (it == itemPaths.end())
+    return false;
+  *path = it->second;
+  return true;
+}
+
+void RememberItemPath(const std::string& service,
+                      const std::string& account,
+                      const gchar* path) {
+  std::lock_guard<std::mutex> lock(itemPathsLock);
+  itemPaths[ItemKey(service, account)] = path;
+}
+
+void ForgetItemPath(const std::string& service, const std::string& account) {
+  std::lock_guard<std::mutex> lock(itemPathsLock);
+  itemPaths.erase(ItemKey(service, account));
+}
+
+void ForgetItemPaths(const std::string& service) {
+  std::lock_guard<std::mutex> lock(itemPathsLock);
+  std::map<ItemKey, std::string>::iterator it =
+    itemPaths.lower_bound(ItemKey(service, std::string()));
+  while (it != itemPaths.end() && it->first.first == service)
+    itemPaths.erase(it++);
+}
+
+// The Secret Service connection: libsecret's shared SecretService with its
+// session and D-Bus connection, plus the collection proxies cached below.
+// Every call holds a ConnectionScope while it talks to the service.
+// Disconnect drops all of it once no call is running, and the next call
+// connects again.
+struct ConnectionState {
+  ConnectionState()
+    : active(0),
+      releasing(false),
+      connected(false),
+      idleTimeout(0),
+      watching(false) {}
+
+  std::mutex lock;
+  std::condition_variable changed;
+  int active;
+  // Set while a Disconnect waits for running calls; new calls wait for it.
+  bool releasing;
+  bool connected;
+  std::chrono::milliseconds idleTimeout;
+  std::chrono::steady_clock::time_point lastUse;
+  // Whether the WatchIdle thread is running.
+  bool watching;
+};
+
+// Never destroyed, so that a WatchIdle thread still running at exit doesn't
+// use a destroyed mutex.
+ConnectionState& Connection() {
+  static ConnectionState* state = new ConnectionState();
+  return *state;
+}
+
+void ForgetCollections();
+
+// Called with the state locked, no call active and `releasing` set.
+void Disconnect(ConnectionState* state) {
+  ForgetCollections();
+  secret_service_disconnect();
+  state->connected = false;
+#ifdef __GLIBC__
+  // Hand the freed proxy and D-Bus buffers back to the system.
+  malloc_trim(0);
+#endif
+}
+
+// Waits, with the state locked, until no call is running and disconnects.
+void DisconnectWhenIdle(ConnectionState* state,
+                        std::unique_lock<std::mutex>* lock) {
+  state->releasing = true;
+  while (state->active > 0)
+    state->changed.wait(*lock);
+  Disconnect(state);
+  state->releasing = false;
+  state->changed.notify_all();
+}
+
+// Runs on its own thread while an idle timeout is set and the service is
+// connected, and disconnects once no call has been made for the timeout.
+void WatchIdle() {
+  ConnectionState& state = Connection();
+  std::unique_lock<std::mutex> lock(state.lock);
+  while (state.connected && state.idleTimeout.count() > 0) {
+    if (state.active > 0 || state.releasing) {
+      state.changed.wait(lock);
+      continue;
+    }
+    std::chrono::steady_clock::time_point deadline =
+      state.lastUse + state.idleTimeout;
+    if (std::chrono::steady_clock::now() >= deadline) {
+      DisconnectWhenIdle(&state, &lock);
+      break;
+    }
+    state.changed.wait_until(lock, deadline);
+  }
+  state.watching = false;
+}
+
+// Called with the state locked.
+void StartWatchingIdle(ConnectionState* state) {
+  if (state->watching || !state->connected || state->idleTimeout.count() == 0)
+    return;
+  state->watching = true;
+  std::thread(WatchIdle).detach();
+}
+
+class ConnectionScope {
+  public:
+    ConnectionScope() {
+      ConnectionState& state = Connection();
+      std::unique_lock<std::mutex> lock(state.lock);
+      while (state.releasing)
+        state.changed.wait(lock);
+      ++state.active;
+      state.connected = true;
+    }
+
+    ~ConnectionScope() {
+      ConnectionState& state = Connection();
+      std::lock_guard<std::mutex> lock(state.lock);
+      --state.active;
+      state.lastUse = std::chrono::steady_clock::now();
+      state.changed.notify_all();
+      StartWatchingIdle(&state);
+    }
+
+  private:
+    ConnectionScope(const ConnectionScope&);
+    ConnectionScope& operator=(const ConnectionScope&);
+};
+
+// Adds the creation and modification times of `item` to `settings`, in
+// milliseconds since the Unix epoch. The Secret Service keeps them in
+// seconds.
+void AddTimestamps(SecretItem* item,
+                   std::vector<std::pair<std::string, const std::string> >*
+                     settings) {
+  settings->push_back(std::make_pair(
+    std::string("created"),
+    std::to_string(secret_item_get_created(item) * 1000)));
+  settings->push_back(std::make_pair(
+    std::string("modified"),
+    std::to_string(secret_item_get_modified(item) * 1000)));
+}
+
+// Loads the secret of the item for `service` and `account` into `value`,
+// through its cached object path when there is one. Returns FAIL_NONFATAL
+// when no such item exists.
+KEYTAR_OP_RESULT LookupSecret(const std::string& service,
+                              const std::string& account,
+                              SecretValue** value,
+                              std::string* errStr) {
+  GError* error = NULL;
+
+  SecretService* secretService = secret_service_get_sync(
+    SECRET_SERVICE_OPEN_SESSION, NULL, &error);
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  std::string path;
+  if (CachedItemPath(service, account, &path)) {
+    *value = secret_service_get_secret_for_dbus_path_sync(
+      secretService, path.c_str(), NULL, &error);
+    if (*value != NULL) {
+      g_object_unref(secretService);
+      return SUCCESS;
+    }
+    // The item is gone or locked; search for it again.
+    g_clear_error(&error);
+    ForgetItemPath(service, account);
+  }
+
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+  g_hash_table_replace(attributes,
+                       (gpointer) "account",
+                       (gpointer) account.c_str());
+
+  gchar** unlocked = NULL;
+  gchar** locked = NULL;
+  secret_service_search_for_dbus_paths_sync(
+    secretService,
+    &schema,                            // The schema.
+    attributes,
+    NULL,                               // Cancellable. (unneeded)
+    &unlocked,
+    &locked,
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+
+  const gchar* found = NULL;
+  if (error == NULL) {
+    if (unlocked != NULL && unlocked[0] != NULL) {
+      found = unlocked[0];
+    } else if (locked != NULL && locked[0] != NULL && !interactive) {
+      Locked(errStr);
+      g_strfreev(unlocked);
+      g_strfreev(locked);
+      g_object_unref(secretService);
+      return FAIL_ERROR;
+    } else if (locked != NULL && locked[0] != NULL) {
+      const gchar* paths[] = { locked[0], NULL };
+      if (secret_service_unlock_dbus_paths_sync(
+            secretService, paths, NULL, NULL, &error) > 0)
+        found = locked[0];
+    }
+  }
+
+  *value = NULL;
+  if (found != NULL)
+    *value = secret_service_get_secret_for_dbus_path_sync(
+      secretService, found, NULL, &error);
+  if (*value != NULL)
+    RememberItemPath(service, account, found);
+
+  g_strfreev(unlocked);
+  g_strfreev(locked);
+  g_object_unref(secretService);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  return *value != NULL ? SUCCESS : FAIL_NONFATAL;
+}
+
+// Writes `password` over the item whose path LookupSecret cached for
+// `service` and `account`, instead of storing it anew, which has the
+// Secret Service search for the entry again. Returns FAIL_NONFATAL when
+// there is no such item to update.
+KEYTAR_OP_RESULT UpdateCachedItem(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  bool binary,
+                                  std::string* errStr) {
+  std::string path;
+  if (!CachedItemPath(service, account, &path))
+    return FAIL_NONFATAL;
+
+  GError* error = NULL;
+  SecretService* secretService = secret_service_get_sync(
+    SECRET_SERVICE_OPEN_SESSION, NULL, &error);
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  SecretItem* item = secret_item_new_for_dbus_path_sync(
+    secretService, path.c_str(), SECRET_ITEM_NONE, NULL, &error);
+  g_object_unref(secretService);
+  if (item == NULL) {
+    g_clear_error(&error);
+    ForgetItemPath(service, account);
+    return FAIL_NONFATAL;
+  }
+
+  // Text is cut at the first NUL, as secret_password_store_sync does.
+  SecretValue* value = binary ?
+    secret_value_new(password.data(), password.length(), kBinaryContentType) :
+    secret_value_new(password.c_str(), -1, kTextContentType);
+  secret_item_set_secret_sync(item, value, NULL, &error);
+  secret_value_unref(value);
+  g_object_unref(item);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  return SUCCESS;
+}
+
+// FindPassword without prompts: the first text secret among the unlocked
+// items of `service`, failing with kLockedError when only locked items
+// could hold one.
+KEYTAR_OP_RESULT FindUnlockedPassword(const std::string& service,
+                                      std::string* password,
+                                      std::string* errStr) {
+  GError* error = NULL;
+
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+
+  GList* items = secret_service_search_sync(
+    NULL,
+    &schema,                            // The schema.
+    attributes,
+    static_cast<SecretSearchFlags>(SECRET_SEARCH_ALL |
+                                   SECRET_SEARCH_LOAD_SECRETS),
+    NULL,                               // Cancellable. (unneeded)
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  KEYTAR_OP_RESULT result = FAIL_NONFATAL;
+  for (GList* current = items; current != NULL; current = current->next) {
+    SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
+    if (secret_item_get_locked(item)) {
+      result = Locked(errStr);
+      continue;
+    }
+    SecretValue* value = secret_item_get_secret(item);
+    const gchar* text = value != NULL ? secret_value_get_text(value) : NULL;
+    if (text != NULL)
+      *password = text;
+    if (value != NULL)
+      secret_value_unref(value);
+    if (text != NULL) {
+      result = SUCCESS;
+      break;
+    }
+  }
+
+  g_list_free_full(items, g_object_unref);
+  return result;
+}
+
 }  // namespace
 
+KEYTAR_OP_RESULT ConfigureBackend(const BackendOptions& options,
+                                  std::string* errStr) {
+  if (options.name != "default" && options.name != "keyctl") {
+    *errStr = "Unknown backend: " + options.name;
+    return FAIL_ERROR;
+  }
+  return keyctl::Configure(options, errStr);
+}
+
+void SetInteractive(bool allowed) {
+  interactive = allowed;
+}
+
+bool Interactive() {
+  return interactive;
+}
+
+void SetIdleTimeout(unsigned int milliseconds) {
+  ConnectionState& state = Connection();
+  std::lock_guard<std::mutex> lock(state.lock);
+  state.idleTimeout = std::chrono::milliseconds(milliseconds);
+  state.changed.notify_all();
+  StartWatchingIdle(&state);
+}
+
+void ReleaseConnection() {
+  ConnectionState& state = Connection();
+  std::unique_lock<std::mutex> lock(state.lock);
+  while (state.releasing)
+    state.changed.wait(lock);
+  if (state.connected)
+    DisconnectWhenIdle(&state, &lock);
+}
+
 KEYTAR_OP_RESULT SetPassword(const std::string& service,
                              const std::string& account,
                              const std::string& password,
                              std::string* errStr) {
+  BackendProbe probe("set_password");
+  if (keyctl::Enabled())
+    return keyctl::SetPassword(service, account, password, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+  if (CheckDefaultUnlocked(errStr) != SUCCESS)
+    return FAIL_ERROR;
+
   GError* error = NULL;
 
   secret_password_store_sync(
@@ -50,15 +515,65 @@ KEYTAR_OP_RESULT GetPassword(const std::string& service,
                              const std::string& account,
                              std::string* password,
                              std::string* errStr) {
+  BackendProbe probe("get_password");
+  if (keyctl::Enabled())
+    return keyctl::GetPassword(service, account, password, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  SecretValue* value = NULL;
+  KEYTAR_OP_RESULT result = LookupSecret(service, account, &value, errStr);
+  if (result != SUCCESS)
+    return result;
+
+  // Like secret_password_lookup_sync, treat secrets that aren't text as
+  // missing.
+  const gchar* text = secret_value_get_text(value);
+  if (text != NULL)
+    *password = text;
+  secret_value_unref(value);
+  return text != NULL ? SUCCESS : FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT SetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   const std::string& data,
+                                   std::string* errStr) {
+  BackendProbe probe("set_password_binary");
+  if (keyctl::Enabled())
+    return keyctl::SetPassword(service, account, data, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+  if (CheckDefaultUnlocked(errStr) != SUCCESS)
+    return FAIL_ERROR;
+
   GError* error = NULL;
 
-  gchar* raw_password = secret_password_lookup_sync(
+  SecretValue* value = secret_value_new(data.data(),
+                                        data.length(),
+                                        kBinaryContentType);
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+  g_hash_table_replace(attributes,
+                       (gpointer) "account",
+                       (gpointer) account.c_str());
+
+  secret_service_store_sync(
+    NULL,                               // The default service.
     &schema,                            // The schema.
+    attributes,
+    SECRET_COLLECTION_DEFAULT,          // Default collection.
+    (service + "/" + account).c_str(),  // The label.
+    value,                              // The secret bytes.
     NULL,                               // Cancellable. (unneeded)
-    &error,                             // Reference to the error.
-    "service", service.c_str(),
-    "account", account.c_str(),
-    NULL);                              // End of arguments.
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+  secret_value_unref(value);
 
   if (error != NULL) {
     *errStr = std::string(error->message);
@@ -66,19 +581,140 @@ KEYTAR_OP_RESULT GetPassword(const std::string& service,
     return FAIL_ERROR;
   }
 
-  if (raw_password == NULL)
-    return FAIL_NONFATAL;
+  return SUCCESS;
+}
 
-  *password = raw_password;
-  secret_password_free(raw_password);
+KEYTAR_OP_RESULT GetPasswordBinary(const std::string& service,
+                                   const std::string& account,
+                                   std::string* data,
+                                   std::string* errStr) {
+  BackendProbe probe("get_password_binary");
+  if (keyctl::Enabled())
+    return keyctl::GetPassword(service, account, data, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  SecretValue* value = NULL;
+  KEYTAR_OP_RESULT result = LookupSecret(service, account, &value, errStr);
+  if (result != SUCCESS)
+    return result;
+
+  gsize length = 0;
+  const gchar* bytes = secret_value_get(value, &length);
+  data->assign(bytes, length);
+  secret_value_unref(value);
   return SUCCESS;
 }
 
+KEYTAR_OP_RESULT SetPasswordWithTimeout(const std::string& service,
+                                        const std::string& account,
+                                        const std::string& password,
+                                        bool binary,
+                                        unsigned int timeout,
+                                        std::string* errStr) {
+  BackendProbe probe("set_password_with_timeout");
+  // keyctl stores every value as bytes, so `binary` makes no difference.
+  if (keyctl::Enabled())
+    return keyctl::SetPassword(service, account, password, timeout, errStr);
+  *errStr = kKeyTimeoutsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT ExchangePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  bool binary,
+                                  bool onlyIfMissing,
+                                  std::string* previous,
+                                  std::string* errStr) {
+  BackendProbe probe("exchange_password");
+  KEYTAR_OP_RESULT result;
+  KEYTAR_OP_RESULT written = FAIL_NONFATAL;
+  if (keyctl::Enabled()) {
+    // add_key replaces the payload of an existing key in place, so there
+    // is no item to reuse.
+    result = keyctl::GetPassword(service, account, previous, errStr);
+  } else {
+    if (!LoadLibsecret(errStr))
+      return FAIL_ERROR;
+    ConnectionScope connection;
+
+    SecretValue* value = NULL;
+    result = LookupSecret(service, account, &value, errStr);
+    if (result == FAIL_ERROR)
+      return FAIL_ERROR;
+
+    bool found = result == SUCCESS;
+    if (found && binary) {
+      gsize length = 0;
+      const gchar* bytes = secret_value_get(value, &length);
+      previous->assign(bytes, length);
+    } else if (found) {
+      // Like GetPassword, treat secrets that aren't text as missing.
+      const gchar* text = secret_value_get_text(value);
+      if (text != NULL)
+        *previous = text;
+      else
+        result = FAIL_NONFATAL;
+    }
+    if (value != NULL)
+      secret_value_unref(value);
+
+    if (found && !(result == SUCCESS && onlyIfMissing)) {
+      written = UpdateCachedItem(service, account, password, binary, errStr);
+      if (written == FAIL_ERROR)
+        return FAIL_ERROR;
+    }
+  }
+  if (result == FAIL_ERROR || (result == SUCCESS && onlyIfMissing))
+    return result;
+
+  // Nothing to update in place. The store runs outside the connection
+  // scope above, since it opens its own.
+  if (written == FAIL_NONFATAL) {
+    written = binary ?
+      SetPasswordBinary(service, account, password, errStr) :
+      SetPassword(service, account, password, errStr);
+  }
+  return written == SUCCESS ? result : FAIL_ERROR;
+}
+
 KEYTAR_OP_RESULT DeletePassword(const std::string& service,
                                 const std::string& account,
                                 std::string* errStr) {
+  BackendProbe probe("delete_password");
+  if (keyctl::Enabled())
+    return keyctl::DeletePassword(service, account, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+  if (CheckDefaultUnlocked(errStr) != SUCCESS)
+    return FAIL_ERROR;
+
   GError* error = NULL;
 
+  // The cached path names one item, but copies of the entry can exist in
+  // other collections, so the clear by attributes below always runs too.
+  bool deleted = false;
+  std::string path;
+  if (CachedItemPath(service, account, &path)) {
+    ForgetItemPath(service, account);
+    SecretService* secretService = secret_service_get_sync(
+      SECRET_SERVICE_NONE, NULL, &error);
+    if (error != NULL) {
+      *errStr = std::string(error->message);
+      g_error_free(error);
+      return FAIL_ERROR;
+    }
+
+    deleted = secret_service_delete_item_dbus_path_sync(
+      secretService, path.c_str(), NULL, &error);
+    g_object_unref(secretService);
+    // A stale path fails; the clear finds the item if it still exists.
+    g_clear_error(&error);
+  }
+
   gboolean result = secret_password_clear_sync(
     &schema,                            // The schema.
     NULL,                               // Cancellable. (unneeded)
@@ -93,7 +729,7 @@ KEYTAR_OP_RESULT DeletePassword(const std::string& service,
     return FAIL_ERROR;
   }
 
-  if (!result)
+  if (!result && !deleted)
     return FAIL_NONFATAL;
 
   return SUCCESS;
@@ -102,6 +738,16 @@ KEYTAR_OP_RESULT DeletePassword(const std::string& service,
 KEYTAR_OP_RESULT FindPassword(const std::string& service,
                               std::string* password,
                               std::string* errStr) {
+  BackendProbe probe("find_password");
+  if (keyctl::Enabled())
+    return keyctl::FindPassword(service, password, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  if (!interactive)
+    return FindUnlockedPassword(service, password, errStr);
+
   GError* error = NULL;
 
   gchar* raw_password = secret_password_lookup_sync(
@@ -128,9 +774,16 @@ KEYTAR_OP_RESULT FindPassword(const std::string& service,
 KEYTAR_OP_RESULT FindCredentials(const std::string& service,
                                  std::vector<Credentials>* credentials,
                                  std::string* errStr) {
+  BackendProbe probe("find_credentials");
+  if (keyctl::Enabled())
+    return keyctl::FindCredentials(service, credentials, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
   GError* error = NULL;
 
-  GHashTable* attributes = g_hash_table_new(NULL, NULL);
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
   g_hash_table_replace(attributes,
                        (gpointer) "service",
                        (gpointer) service.c_str());
@@ -139,8 +792,7 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
     NULL,
     &schema,                            // The schema.
     attributes,
-    static_cast<SecretSearchFlags>(SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK |
-                                   SECRET_SEARCH_LOAD_SECRETS),
+    SearchFlags(SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK),
     NULL,                               // Cancellable. (unneeded)
     &error);                             // Reference to the error.
 
@@ -152,33 +804,570 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
     return FAIL_ERROR;
   }
 
-  GList* current = items;
-  for (current = items; current != NULL; current = current->next) {
+  if (!interactive && AnyLocked(items)) {
+    g_list_free_full(items, g_object_unref);
+    return Locked(errStr);
+  }
+
+  for (GList* current = items; current != NULL; current = current->next) {
     SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
+    GHashTable* itemAttrs = secret_item_get_attributes(item);
+    const gchar* account = reinterpret_cast<const gchar*>(
+      g_hash_table_lookup(itemAttrs, "account"));
+    if (account != NULL) {
+      RememberItemPath(service,
+                       account,
+                       g_dbus_proxy_get_object_path(
+                         reinterpret_cast<GDBusProxy*>(item)));
+      std::vector<std::pair<std::string, const std::string> > settings;
+      AddTimestamps(item, &settings);
+      credentials->push_back(Credentials(service, account, settings));
+    }
+    g_hash_table_unref(itemAttrs);
+  }
+
+  g_list_free_full(items, g_object_unref);
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* errStr) {
+  BackendProbe probe("delete_credentials");
+  if (keyctl::Enabled())
+    return keyctl::DeleteCredentials(service, count, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GError* error = NULL;
+
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+
+  GList* items = secret_service_search_sync(
+    NULL,
+    &schema,                            // The schema.
+    attributes,
+    SearchFlags(SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK),
+    NULL,                               // Cancellable. (unneeded)
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  if (!interactive && AnyLocked(items)) {
+    g_list_free_full(items, g_object_unref);
+    return Locked(errStr);
+  }
+
+  ForgetItemPaths(service);
+
+  // Delete the found items directly rather than searching again per item.
+  *count = 0;
+  for (GList* current = items; current != NULL; current = current->next) {
+    SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
+    if (!secret_item_delete_sync(item, NULL, &error)) {
+      *errStr = std::string(error->message);
+      g_error_free(error);
+      g_list_free_full(items, g_object_unref);
+      return FAIL_ERROR;
+    }
+    ++*count;
+  }
+
+  g_list_free_full(items, g_object_unref);
+  return *count > 0 ? SUCCESS : FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* errStr) {
+  BackendProbe probe("find_secrets");
+  if (keyctl::Enabled())
+    return keyctl::FindSecrets(service, secrets, errStr);
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GError* error = NULL;
+
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+
+  GList* items = secret_service_search_sync(
+    NULL,
+    &schema,                            // The schema.
+    attributes,
+    SearchFlags(SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK |
+                SECRET_SEARCH_LOAD_SECRETS),
+    NULL,                               // Cancellable. (unneeded)
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
 
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  if (!interactive && AnyLocked(items)) {
+    g_list_free_full(items, g_object_unref);
+    return Locked(errStr);
+  }
+
+  for (GList* current = items; current != NULL; current = current->next) {
+    SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
     GHashTable* itemAttrs = secret_item_get_attributes(item);
-    char* account = strdup(
-      reinterpret_cast<char*>(g_hash_table_lookup(itemAttrs, "account")));
+    const gchar* account = reinterpret_cast<const gchar*>(
+      g_hash_table_lookup(itemAttrs, "account"));
+    SecretValue* value = secret_item_get_secret(item);
+    if (account != NULL && value != NULL) {
+      StoredSecret found;
+      found.account = account;
+      gsize length = 0;
+      const gchar* bytes = secret_value_get(value, &length);
+      found.secret.assign(bytes, length);
+      found.text = secret_value_get_text(value) != NULL;
+      secrets->push_back(found);
+      RememberItemPath(service,
+                       account,
+                       g_dbus_proxy_get_object_path(
+                         reinterpret_cast<GDBusProxy*>(item)));
+    }
+    if (value != NULL)
+      secret_value_unref(value);
+    g_hash_table_unref(itemAttrs);
+  }
 
-    SecretValue* secret = secret_item_get_secret(item);
-    char* password = strdup(secret_value_get_text(secret));
+  g_list_free_full(items, g_object_unref);
+  return SUCCESS;
+}
 
-    if (account == NULL || password == NULL) {
-      if (account)
-        free(account);
+namespace {
 
-      if (password)
-        free(password);
+// Collections resolved by name, kept for the life of the process. An entry
+// is dropped when an operation on it fails, so a deleted collection is
+// looked up again next time.
+std::mutex collectionsLock;
+std::map<std::string, SecretCollection*> collections;
 
-      continue;
+void ForgetCollection(const std::string& name) {
+  std::lock_guard<std::mutex> lock(collectionsLock);
+  std::map<std::string, SecretCollection*>::iterator it =
+    collections.find(name);
+  if (it != collections.end()) {
+    g_object_unref(it->second);
+    collections.erase(it);
+  }
+}
+
+void ForgetCollections() {
+  std::lock_guard<std::mutex> lock(collectionsLock);
+  std::map<std::string, SecretCollection*>::iterator it;
+  for (it = collections.begin(); it != collections.end(); ++it)
+    g_object_unref(it->second);
+  collections.clear();
+}
+
+// Resolves `name` as a D-Bus object path, an alias or a collection label,
+// in that order. The caller owns a reference to the returned collection.
+KEYTAR_OP_RESULT OpenCollection(const std::string& name,
+                                SecretCollection** collection,
+                                std::string* errStr) {
+  {
+    std::lock_guard<std::mutex> lock(collectionsLock);
+    std::map<std::string, SecretCollection*>::iterator it =
+      collections.find(name);
+    if (it != collections.end()) {
+      *collection = reinterpret_cast<SecretCollection*>(
+        g_object_ref(it->second));
+      return SUCCESS;
     }
+  }
+
+  GError* error = NULL;
+  SecretService* secretService = secret_service_get_sync(
+    SECRET_SERVICE_OPEN_SESSION, NULL, &error);
+  SecretCollection* found = NULL;
 
-    credentials->push_back(Credentials(account, password));
-    free(account);
-    free(password);
+  if (error == NULL && name[0] == '/') {
+    found = secret_collection_new_for_dbus_path_sync(
+      secretService, name.c_str(), SECRET_COLLECTION_NONE, NULL, &error);
+  } else if (error == NULL) {
+    found = secret_collection_for_alias_sync(
+      secretService, name.c_str(), SECRET_COLLECTION_NONE, NULL, &error);
+    if (found == NULL && error == NULL &&
+        secret_service_load_collections_sync(secretService, NULL, &error)) {
+      GList* all = secret_service_get_collections(secretService);
+      for (GList* current = all; current != NULL; current = current->next) {
+        SecretCollection* candidate =
+          reinterpret_cast<SecretCollection*>(current->data);
+        gchar* label = secret_collection_get_label(candidate);
+        if (found == NULL && label != NULL && name == label)
+          found = reinterpret_cast<SecretCollection*>(
+            g_object_ref(candidate));
+        g_free(label);
+      }
+      g_list_free_full(all, g_object_unref);
+    }
   }
 
+  if (secretService != NULL)
+    g_object_unref(secretService);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+  if (found == NULL) {
+    *errStr = "No collection named " + name;
+    return FAIL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(collectionsLock);
+  std::map<std::string, SecretCollection*>::iterator it =
+    collections.find(name);
+  if (it != collections.end()) {
+    // Another thread resolved it first.
+    g_object_unref(found);
+    found = it->second;
+  } else {
+    collections[name] = found;
+  }
+  *collection = reinterpret_cast<SecretCollection*>(g_object_ref(found));
   return SUCCESS;
 }
 
+// Searches one collection for the items of `service`, and of `account`
+// when it isn't NULL. The caller frees `items` with g_list_free_full.
+KEYTAR_OP_RESULT SearchCollection(const std::string& name,
+                                  const std::string& service,
+                                  const std::string* account,
+                                  SecretSearchFlags flags,
+                                  GList** items,
+                                  std::string* errStr) {
+  SecretCollection* collection = NULL;
+  if (OpenCollection(name, &collection, errStr) != SUCCESS)
+    return FAIL_ERROR;
+
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+  if (account != NULL)
+    g_hash_table_replace(attributes,
+                         (gpointer) "account",
+                         (gpointer) account->c_str());
+
+  GError* error = NULL;
+  *items = secret_collection_search_sync(
+    collection,
+    &schema,                            // The schema.
+    attributes,
+    SearchFlags(flags),
+    NULL,                               // Cancellable. (unneeded)
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+  g_object_unref(collection);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    ForgetCollection(name);
+    return FAIL_ERROR;
+  }
+
+  if (!interactive && AnyLocked(*items)) {
+    g_list_free_full(*items, g_object_unref);
+    *items = NULL;
+    return Locked(errStr);
+  }
+
+  return SUCCESS;
+}
+
+// Copies the secret of the first of `items`, as text unless `binary`.
+KEYTAR_OP_RESULT FirstSecret(GList* items, bool binary, std::string* out) {
+  if (items == NULL)
+    return FAIL_NONFATAL;
+
+  SecretValue* value = secret_item_get_secret(
+    reinterpret_cast<SecretItem*>(items->data));
+  if (value == NULL)
+    return FAIL_NONFATAL;
+
+  KEYTAR_OP_RESULT result = SUCCESS;
+  if (binary) {
+    gsize length = 0;
+    const gchar* bytes = secret_value_get(value, &length);
+    out->assign(bytes, length);
+  } else if (const gchar* text = secret_value_get_text(value)) {
+    *out = text;
+  } else {
+    result = FAIL_NONFATAL;
+  }
+  secret_value_unref(value);
+  return result;
+}
+
+}  // namespace
+
+KEYTAR_OP_RESULT SetPasswordInCollection(const std::string& name,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         const std::string& password,
+                                         bool binary,
+                                         std::string* errStr) {
+  BackendProbe probe("set_password_in_collection");
+  if (keyctl::Enabled()) {
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  SecretCollection* collection = NULL;
+  if (OpenCollection(name, &collection, errStr) != SUCCESS)
+    return FAIL_ERROR;
+  if (!interactive && secret_collection_get_locked(collection)) {
+    g_object_unref(collection);
+    return Locked(errStr);
+  }
+
+  SecretValue* value = secret_value_new(password.data(),
+                                        password.length(),
+                                        binary ? kBinaryContentType :
+                                                 "text/plain");
+  GHashTable* attributes = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_replace(attributes,
+                       (gpointer) "service",
+                       (gpointer) service.c_str());
+  g_hash_table_replace(attributes,
+                       (gpointer) "account",
+                       (gpointer) account.c_str());
+
+  GError* error = NULL;
+  secret_service_store_sync(
+    NULL,                               // The default service.
+    &schema,                            // The schema.
+    attributes,
+    g_dbus_proxy_get_object_path(reinterpret_cast<GDBusProxy*>(collection)),
+    (service + "/" + account).c_str(),  // The label.
+    value,                              // The secret.
+    NULL,                               // Cancellable. (unneeded)
+    &error);                            // Reference to the error.
+
+  g_hash_table_destroy(attributes);
+  secret_value_unref(value);
+  g_object_unref(collection);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    ForgetCollection(name);
+    return FAIL_ERROR;
+  }
+
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT GetPasswordInCollection(const std::string& name,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         bool binary,
+                                         std::string* password,
+                                         std::string* errStr) {
+  BackendProbe probe("get_password_in_collection");
+  if (keyctl::Enabled()) {
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GList* items = NULL;
+  if (SearchCollection(name, service, &account,
+                       static_cast<SecretSearchFlags>(
+                         SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS),
+                       &items, errStr) != SUCCESS)
+    return FAIL_ERROR;
+
+  KEYTAR_OP_RESULT result = FirstSecret(items, binary, password);
+  g_list_free_full(items, g_object_unref);
+  return result;
+}
+
+KEYTAR_OP_RESULT DeletePasswordInCollection(const std::string& name,
+                                            const std::string& service,
+                                            const std::string& account,
+                                            std::string* errStr) {
+  BackendProbe probe("delete_password_in_collection");
+  if (keyctl::Enabled()) {
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GList* items = NULL;
+  if (SearchCollection(name, service, &account,
+                       static_cast<SecretSearchFlags>(
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK),
+                       &items, errStr) != SUCCESS)
+    return FAIL_ERROR;
+
+  KEYTAR_OP_RESULT result = items != NULL ? SUCCESS : FAIL_NONFATAL;
+  for (GList* current = items; current != NULL; current = current->next) {
+    GError* error = NULL;
+    SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
+    if (!secret_item_delete_sync(item, NULL, &error)) {
+      *errStr = std::string(error->message);
+      g_error_free(error);
+      result = FAIL_ERROR;
+      break;
+    }
+  }
+
+  g_list_free_full(items, g_object_unref);
+  return result;
+}
+
+KEYTAR_OP_RESULT FindPasswordInCollection(const std::string& name,
+                                          const std::string& service,
+                                          std::string* password,
+                                          std::string* errStr) {
+  BackendProbe probe("find_password_in_collection");
+  if (keyctl::Enabled()) {
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GList* items = NULL;
+  if (SearchCollection(name, service, NULL,
+                       static_cast<SecretSearchFlags>(
+                         SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS),
+                       &items, errStr) != SUCCESS)
+    return FAIL_ERROR;
+
+  KEYTAR_OP_RESULT result = FirstSecret(items, false, password);
+  g_list_free_full(items, g_object_unref);
+  return result;
+}
+
+KEYTAR_OP_RESULT FindCredentialsInCollection(
+    const std::string& name,
+    const std::string& service,
+    std::vector<Credentials>* credentials,
+    std::string* errStr) {
+  BackendProbe probe("find_credentials_in_collection");
+  if (keyctl::Enabled()) {
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  GList* items = NULL;
+  if (SearchCollection(name, service, NULL,
+                       static_cast<SecretSearchFlags>(
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK),
+                       &items, errStr) != SUCCESS)
+    return FAIL_ERROR;
+
+  for (GList* current = items; current != NULL; current = current->next) {
+    SecretItem* item = reinterpret_cast<SecretItem*>(current->data);
+    GHashTable* itemAttrs = secret_item_get_attributes(item);
+    const gchar* account = reinterpret_cast<const gchar*>(
+      g_hash_table_lookup(itemAttrs, "account"));
+    if (account != NULL) {
+      std::vector<std::pair<std::string, const std::string> > settings;
+      settings.push_back(std::make_pair(std::string("collection"), name));
+      AddTimestamps(item, &settings);
+      credentials->push_back(Credentials(service, account, settings));
+    }
+    g_hash_table_unref(itemAttrs);
+  }
+
+  g_list_free_full(items, g_object_unref);
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT Unlock(const std::vector<std::string>& names,
+                        std::string* errStr) {
+  BackendProbe probe("unlock");
+  if (keyctl::Enabled()) {
+    // Kernel keyrings aren't locked.
+    if (names.empty())
+      return SUCCESS;
+    *errStr = keyctl::kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  if (!LoadLibsecret(errStr))
+    return FAIL_ERROR;
+  ConnectionScope connection;
+
+  std::vector<std::string> wanted(names);
+  if (wanted.empty())
+    wanted.push_back("default");
+
+  GList* lockedCollections = NULL;
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    SecretCollection* collection = NULL;
+    if (OpenCollection(wanted[i], &collection, errStr) != SUCCESS) {
+      g_list_free_full(lockedCollections, g_object_unref);
+      return FAIL_ERROR;
+    }
+    if (secret_collection_get_locked(collection))
+      lockedCollections = g_list_append(lockedCollections, collection);
+    else
+      g_object_unref(collection);
+  }
+  if (lockedCollections == NULL)
+    return SUCCESS;
+
+  // One Unlock call, so the user sees a single prompt for all of them.
+  GError* error = NULL;
+  GList* unlocked = NULL;
+  gint count = secret_service_unlock_sync(
+    NULL,                               // The default service.
+    lockedCollections,
+    NULL,                               // Cancellable. (unneeded)
+    &unlocked,
+    &error);                            // Reference to the error.
+
+  guint requested = g_list_length(lockedCollections);
+  g_list_free_full(unlocked, g_object_unref);
+  g_list_free_full(lockedCollections, g_object_unref);
+
+  if (error != NULL) {
+    *errStr = std::string(error->message);
+    g_error_free(error);
+    return FAIL_ERROR;
+  }
+
+  // The user dismissed the prompt.
+  return count >= 0 && static_cast<guint>(count) == requested ?
+         SUCCESS : FAIL_NONFATAL;
+}
+
 }  // namespace keytar
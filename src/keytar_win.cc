@@ -9,6 +9,19 @@
 
 namespace keytar {
 
+// Converts a FILETIME (100ns intervals since 1601) to milliseconds since
+// the Unix epoch, as a string.
+std::string fileTimeToEpochMillis(const FILETIME& time) {
+  ULARGE_INTEGER ticks;
+  ticks.LowPart = time.dwLowDateTime;
+  ticks.HighPart = time.dwHighDateTime;
+  const ULONGLONG kEpochOffset = 116444736000000000ULL;
+  if (ticks.QuadPart < kEpochOffset) {
+    return "0";
+  }
+  return std::to_string((ticks.QuadPart - kEpochOffset) / 10000);
+}
+
 LPWSTR utf8ToWideChar(std::string utf8) {
   int wide_char_length = MultiByteToWideChar(CP_UTF8,
                                              0,
@@ -173,6 +186,38 @@ KEYTAR_OP_RESULT GetPassword(const std::string& service,
   return SUCCESS;
 }
 
+KEYTAR_OP_RESULT SetPasswordBinary(const std::string& service,
+                       const std::string& account,
+                       const std::string& data,
+                       std::string* errStr) {
+  // CredentialBlob is an opaque byte array, so no conversion is needed.
+  return SetPassword(service, account, data, errStr);
+}
+
+KEYTAR_OP_RESULT GetPasswordBinary(const std::string& service,
+                       const std::string& account,
+                       std::string* data,
+                       std::string* errStr) {
+  return GetPassword(service, account, data, errStr);
+}
+
+KEYTAR_OP_RESULT ExchangePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  bool binary,
+                                  bool onlyIfMissing,
+                                  std::string* previous,
+                                  std::string* errStr) {
+  // CredWrite replaces a credential by target name without looking it up,
+  // so the read and write below already touch the entry only once each.
+  KEYTAR_OP_RESULT result = GetPassword(service, account, previous, errStr);
+  if (result == FAIL_ERROR || (result == SUCCESS && onlyIfMissing))
+    return result;
+
+  KEYTAR_OP_RESULT written = SetPassword(service, account, password, errStr);
+  return written == SUCCESS ? result : FAIL_ERROR;
+}
+
 KEYTAR_OP_RESULT DeletePassword(const std::string& service,
                     const std::string& account,
                     std::string* errStr) {
@@ -251,12 +296,11 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
     }
 
     std::string login = wideCharToUtf8(cred->UserName);
-    std::string password(
-      reinterpret_cast<char*>(
-        cred->CredentialBlob),
-        cred->CredentialBlobSize);
-
-    credentials->push_back(Credentials(login, password));
+    // Windows only records when a credential was last written.
+    std::vector<std::pair<std::string, const std::string> > settings;
+    settings.push_back(std::make_pair(std::string("modified"),
+                                      fileTimeToEpochMillis(cred->LastWritten)));
+    credentials->push_back(Credentials(service, login, settings));
   }
 
   CredFree(creds);
@@ -264,5 +308,184 @@ KEYTAR_OP_RESULT FindCredentials(const std::string& service,
   return SUCCESS;
 }
 
+KEYTAR_OP_RESULT DeleteCredentials(const std::string& service,
+                                   size_t* count,
+                                   std::string* errStr) {
+  LPWSTR filter = utf8ToWideChar(service + "/*");
+  if (filter == NULL) {
+    return FAIL_ERROR;
+  }
+
+  DWORD found;
+  CREDENTIAL** creds;
+  bool result = ::CredEnumerate(filter, 0, &found, &creds);
+  delete[] filter;
+  if (!result) {
+    DWORD code = ::GetLastError();
+    if (code == ERROR_NOT_FOUND) {
+      return FAIL_NONFATAL;
+    } else {
+      *errStr = getErrorMessage(code);
+      return FAIL_ERROR;
+    }
+  }
+
+  // Delete the enumerated credentials by target name directly.
+  *count = 0;
+  for (DWORD i = 0; i < found; ++i) {
+    if (!::CredDelete(creds[i]->TargetName, CRED_TYPE_GENERIC, 0)) {
+      DWORD code = ::GetLastError();
+      if (code == ERROR_NOT_FOUND) {
+        continue;
+      }
+      *errStr = getErrorMessage(code);
+      ::CredFree(creds);
+      return FAIL_ERROR;
+    }
+    ++*count;
+  }
+
+  ::CredFree(creds);
+  return *count > 0 ? SUCCESS : FAIL_NONFATAL;
+}
+
+KEYTAR_OP_RESULT FindSecrets(const std::string& service,
+                             std::vector<StoredSecret>* secrets,
+                             std::string* errStr) {
+  LPWSTR filter = utf8ToWideChar(service + "/*");
+  if (filter == NULL) {
+    return FAIL_ERROR;
+  }
+
+  // CredEnumerate returns the credential blobs along with the names.
+  DWORD count;
+  CREDENTIAL** creds;
+  bool result = ::CredEnumerate(filter, 0, &count, &creds);
+  delete[] filter;
+  if (!result) {
+    DWORD code = ::GetLastError();
+    if (code == ERROR_NOT_FOUND) {
+      return SUCCESS;
+    } else {
+      *errStr = getErrorMessage(code);
+      return FAIL_ERROR;
+    }
+  }
+
+  for (DWORD i = 0; i < count; ++i) {
+    CREDENTIAL* cred = creds[i];
+    if (cred->UserName == NULL) {
+      continue;
+    }
+
+    StoredSecret found;
+    found.account = wideCharToUtf8(cred->UserName);
+    found.secret = std::string(reinterpret_cast<char*>(cred->CredentialBlob),
+                               cred->CredentialBlobSize);
+    found.text = true;
+    secrets->push_back(found);
+  }
+
+  ::CredFree(creds);
+  return SUCCESS;
+}
+
+namespace {
+
+const char kCollectionsUnsupported[] =
+    "Collections are not supported on this platform";
+
+const char kKeyTimeoutsUnsupported[] =
+    "Key timeouts are not supported on this platform";
+
+}  // namespace
+
+KEYTAR_OP_RESULT SetPasswordWithTimeout(const std::string& service,
+                                        const std::string& account,
+                                        const std::string& password,
+                                        bool binary,
+                                        unsigned int timeout,
+                                        std::string* errStr) {
+  *errStr = kKeyTimeoutsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT SetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         const std::string& password,
+                                         bool binary,
+                                         std::string* error) {
+  *error = kCollectionsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT GetPasswordInCollection(const std::string& collection,
+                                         const std::string& service,
+                                         const std::string& account,
+                                         bool binary,
+                                         std::string* password,
+                                         std::string* error) {
+  *error = kCollectionsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT DeletePasswordInCollection(const std::string& collection,
+                                            const std::string& service,
+                                            const std::string& account,
+                                            std::string* error) {
+  *error = kCollectionsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindPasswordInCollection(const std::string& collection,
+                                          const std::string& service,
+                                          std::string* password,
+                                          std::string* error) {
+  *error = kCollectionsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT FindCredentialsInCollection(const std::string& collection,
+                                             const std::string& service,
+                                             std::vector<Credentials>* credentials,
+                                             std::string* error) {
+  *error = kCollectionsUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT ConfigureBackend(const BackendOptions& options,
+                                  std::string* error) {
+  if (options.name == "default")
+    return SUCCESS;
+  *error = "Backend not available on this platform: " + options.name;
+  return FAIL_ERROR;
+}
+
+void SetIdleTimeout(unsigned int milliseconds) {
+}
+
+void ReleaseConnection() {
+}
+
+// Credential Manager never prompts, so there is nothing to disable or
+// unlock.
+const char kLockedError[] = "The credential store is locked";
+
+void SetInteractive(bool interactive) {
+}
+
+bool Interactive() {
+  return true;
+}
+
+KEYTAR_OP_RESULT Unlock(const std::vector<std::string>& collections,
+                        std::string* error) {
+  if (!collections.empty()) {
+    *error = kCollectionsUnsupported;
+    return FAIL_ERROR;
+  }
+  return SUCCESS;
+}
 
 }  // namespace keytar
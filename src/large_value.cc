@@ -0,0 +1,374 @@
+#include "large_value.h"
+
+#include <zlib.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "operations.h"
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include "keytar_keyctl.h"
+#endif
+
+namespace keytar {
+
+namespace {
+
+// Largest blob stored in a single keychain entry. Windows rejects credential
+// blobs above CRED_MAX_CREDENTIAL_BLOB_SIZE (5 * 512 bytes) and the kernel
+// keyring above keyctl::kMaxPayloadSize; the other backends have no hard
+// limit, but very large D-Bus messages are slow.
+size_t MaxItemSize() {
+#if defined(_WIN32)
+  return 5 * 512;
+#else
+#if !defined(__APPLE__)
+  if (keyctl::Enabled())
+    return keyctl::kMaxPayloadSize;
+#endif
+  return 1024 * 1024;
+#endif
+}
+
+// Manifest layout, all integers little-endian:
+//   magic "KTLV" | version u8 | flags u8 | reserved u16 | generation u32 |
+//   chunk count u32 | original length u64 | stored length u64 | crc32 u32 |
+//   header crc32 u32
+// followed by the stored payload itself when chunk count is zero. The
+// header crc32 covers the bytes before it, so a value stored through the
+// regular API is only taken for a manifest if it happens to carry a valid
+// checksum of its own first 36 bytes.
+const char kMagic[] = { 'K', 'T', 'L', 'V' };
+const uint8_t kVersion = 2;
+const uint8_t kFlagCompressed = 1 << 0;
+const size_t kChecksummedSize = 36;
+const size_t kHeaderSize = 40;
+
+// Chunks live under a separate service so they don't show up when the
+// caller's service is enumerated. The name starts with the prefix rather
+// than the caller's service because the Windows backend enumerates a
+// service by matching "<service>/*" against target names.
+const char kChunkServicePrefix[] = ".keytar-chunks/";
+
+// How often a read is retried when a concurrent writer replaced the value
+// between reading the manifest and reading its chunks.
+const int kMaxReadAttempts = 3;
+
+struct Manifest {
+  uint8_t flags;
+  uint32_t generation;
+  uint32_t chunkCount;
+  uint64_t originalLength;
+  uint64_t storedLength;
+  uint32_t crc;
+};
+
+void PutUint(std::string* out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint64_t GetUint(const std::string& in, size_t offset, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(
+      static_cast<unsigned char>(in[offset + i])) << (8 * i);
+  }
+  return value;
+}
+
+uint32_t Checksum(const char* data, size_t size) {
+  return static_cast<uint32_t>(
+    crc32(crc32(0L, Z_NULL, 0),
+          reinterpret_cast<const Bytef*>(data),
+          static_cast<uInt>(size)));
+}
+
+uint32_t Checksum(const std::string& data) {
+  return Checksum(data.data(), data.size());
+}
+
+std::string EncodeManifest(const Manifest& manifest) {
+  std::string out(kMagic, sizeof(kMagic));
+  PutUint(&out, kVersion, 1);
+  PutUint(&out, manifest.flags, 1);
+  PutUint(&out, 0, 2);
+  PutUint(&out, manifest.generation, 4);
+  PutUint(&out, manifest.chunkCount, 4);
+  PutUint(&out, manifest.originalLength, 8);
+  PutUint(&out, manifest.storedLength, 8);
+  PutUint(&out, manifest.crc, 4);
+  PutUint(&out, Checksum(out), 4);
+  return out;
+}
+
+// Only accepts headers with a valid checksum whose fields agree with each
+// other and with the size of the entry.
+bool DecodeManifest(const std::string& data, Manifest* manifest) {
+  if (data.size() < kHeaderSize ||
+      data.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0 ||
+      GetUint(data, 4, 1) != kVersion ||
+      GetUint(data, kChecksummedSize, 4) !=
+        Checksum(data.data(), kChecksummedSize)) {
+    return false;
+  }
+
+  manifest->flags = static_cast<uint8_t>(GetUint(data, 5, 1));
+  manifest->generation = static_cast<uint32_t>(GetUint(data, 8, 4));
+  manifest->chunkCount = static_cast<uint32_t>(GetUint(data, 12, 4));
+  manifest->originalLength = GetUint(data, 16, 8);
+  manifest->storedLength = GetUint(data, 24, 8);
+  manifest->crc = static_cast<uint32_t>(GetUint(data, 32, 4));
+
+  uint64_t expectedSize = kHeaderSize;
+  if (manifest->chunkCount == 0)
+    expectedSize += manifest->storedLength;
+  return GetUint(data, 6, 2) == 0 &&
+         (manifest->flags & ~kFlagCompressed) == 0 &&
+         manifest->originalLength <= kMaxLargeValueSize &&
+         manifest->storedLength <= kMaxLargeValueSize &&
+         ((manifest->flags & kFlagCompressed) ||
+          manifest->originalLength == manifest->storedLength) &&
+         data.size() == expectedSize;
+}
+
+std::string ChunkService(const std::string& service) {
+  return kChunkServicePrefix + service;
+}
+
+std::string ChunkAccount(const std::string& account,
+                         uint32_t generation,
+                         uint32_t index) {
+  return account + "/" + std::to_string(generation) + "/" +
+    std::to_string(index);
+}
+
+// Best-effort removal of the chunks belonging to one generation. Missing
+// chunks are expected after an interrupted write and are ignored.
+void DeleteChunks(const std::string& service,
+                  const std::string& account,
+                  uint32_t generation,
+                  uint32_t chunkCount) {
+  std::string ignored;
+  for (uint32_t i = 0; i < chunkCount; ++i) {
+    DeletePassword(ChunkService(service),
+                   ChunkAccount(account, generation, i),
+                   &ignored);
+  }
+}
+
+bool Compress(const std::string& in, std::string* out) {
+  uLongf length = compressBound(static_cast<uLong>(in.size()));
+  out->resize(length);
+  int status = compress2(reinterpret_cast<Bytef*>(&(*out)[0]),
+                         &length,
+                         reinterpret_cast<const Bytef*>(in.data()),
+                         static_cast<uLong>(in.size()),
+                         Z_DEFAULT_COMPRESSION);
+  if (status != Z_OK)
+    return false;
+
+  out->resize(length);
+  return true;
+}
+
+bool Decompress(const std::string& in, uint64_t originalLength,
+                std::string* out) {
+  // DecodeManifest already rejects larger ones; the length comes from the
+  // keychain, so check again before allocating it.
+  if (originalLength > kMaxLargeValueSize)
+    return false;
+  uLongf length = static_cast<uLongf>(originalLength);
+  out->resize(length);
+  int status = uncompress(reinterpret_cast<Bytef*>(&(*out)[0]),
+                          &length,
+                          reinterpret_cast<const Bytef*>(in.data()),
+                          static_cast<uLong>(in.size()));
+  return status == Z_OK && length == originalLength;
+}
+
+// Reads the manifest stored under (service, account). `isManifest` is false
+// when the entry holds a value written through the regular API.
+KEYTAR_OP_RESULT ReadManifest(const std::string& service,
+                              const std::string& account,
+                              std::string* raw,
+                              Manifest* manifest,
+                              bool* isManifest,
+                              std::string* error) {
+  KEYTAR_OP_RESULT result = GetPasswordBinary(service, account, raw, error);
+  if (result != SUCCESS)
+    return result;
+
+  *isManifest = DecodeManifest(*raw, manifest);
+  return SUCCESS;
+}
+
+}  // namespace
+
+KEYTAR_OP_RESULT SetLargePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  size_t compressThreshold,
+                                  std::string* error) {
+  if (password.size() > kMaxLargeValueSize) {
+    *error = "Value exceeds the large-value limit of " +
+             std::to_string(kMaxLargeValueSize) + " bytes.";
+    return FAIL_ERROR;
+  }
+
+  // Keeps a concurrent write of the same key from replacing the manifest
+  // between our read and write, which would orphan one of the chunk sets.
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+  std::string raw;
+  Manifest previous;
+  bool hadManifest = false;
+  KEYTAR_OP_RESULT result = ReadManifest(service, account, &raw, &previous,
+                                         &hadManifest, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+  if (result == FAIL_NONFATAL)
+    hadManifest = false;
+
+  Manifest manifest;
+  manifest.flags = 0;
+  manifest.originalLength = password.size();
+
+  std::string payload;
+  if (password.size() >= compressThreshold &&
+      Compress(password, &payload) && payload.size() < password.size()) {
+    manifest.flags |= kFlagCompressed;
+  } else {
+    payload = password;
+  }
+  manifest.storedLength = payload.size();
+  manifest.crc = Checksum(payload);
+
+  // Pick a generation that can't collide with the chunks we're replacing.
+  std::random_device random;
+  do {
+    manifest.generation = random();
+  } while (hadManifest && manifest.generation == previous.generation);
+
+  std::string entry;
+  const size_t maxItemSize = MaxItemSize();
+  if (kHeaderSize + payload.size() <= maxItemSize) {
+    manifest.chunkCount = 0;
+    entry = EncodeManifest(manifest) + payload;
+  } else {
+    manifest.chunkCount = static_cast<uint32_t>(
+      (payload.size() + maxItemSize - 1) / maxItemSize);
+    for (uint32_t i = 0; i < manifest.chunkCount; ++i) {
+      result = SetPasswordBinary(
+        ChunkService(service),
+        ChunkAccount(account, manifest.generation, i),
+        payload.substr(i * maxItemSize, maxItemSize),
+        error);
+      if (result != SUCCESS) {
+        DeleteChunks(service, account, manifest.generation, i);
+        return FAIL_ERROR;
+      }
+    }
+    entry = EncodeManifest(manifest);
+  }
+
+  // Writing the manifest is the commit point of the update.
+  result = SetPasswordBinary(service, account, entry, error);
+  if (result != SUCCESS) {
+    DeleteChunks(service, account, manifest.generation, manifest.chunkCount);
+    return FAIL_ERROR;
+  }
+
+  if (hadManifest)
+    DeleteChunks(service, account, previous.generation, previous.chunkCount);
+
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT GetLargePassword(const std::string& service,
+                                  const std::string& account,
+                                  std::string* password,
+                                  std::string* error) {
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+    std::string raw;
+    Manifest manifest;
+    bool isManifest = false;
+    KEYTAR_OP_RESULT result = ReadManifest(service, account, &raw, &manifest,
+                                           &isManifest, error);
+    if (result != SUCCESS)
+      return result;
+
+    if (!isManifest) {
+      *password = raw;
+      return SUCCESS;
+    }
+
+    std::string payload;
+    if (manifest.chunkCount == 0) {
+      payload = raw.substr(kHeaderSize);
+    } else {
+      payload.reserve(manifest.storedLength);
+      for (uint32_t i = 0; i < manifest.chunkCount; ++i) {
+        std::string chunk;
+        result = GetPasswordBinary(
+          ChunkService(service),
+          ChunkAccount(account, manifest.generation, i),
+          &chunk,
+          error);
+        if (result == FAIL_ERROR)
+          return FAIL_ERROR;
+        if (result == FAIL_NONFATAL)
+          break;
+        payload += chunk;
+      }
+    }
+
+    if (payload.size() != manifest.storedLength ||
+        Checksum(payload) != manifest.crc) {
+      // A writer replaced the value while we were reading; start over from
+      // the new manifest.
+      continue;
+    }
+
+    if (manifest.flags & kFlagCompressed) {
+      if (!Decompress(payload, manifest.originalLength, password)) {
+        *error = "Stored value could not be decompressed.";
+        return FAIL_ERROR;
+      }
+    } else {
+      password->swap(payload);
+    }
+    return SUCCESS;
+  }
+
+  *error = "Stored value is incomplete or corrupted.";
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT DeleteLargePassword(const std::string& service,
+                                     const std::string& account,
+                                     std::string* error) {
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+  std::string raw;
+  Manifest manifest;
+  bool isManifest = false;
+  KEYTAR_OP_RESULT result = ReadManifest(service, account, &raw, &manifest,
+                                         &isManifest, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+
+  // Remove the manifest first so readers never follow it to missing chunks.
+  result = DeletePassword(service, account, error);
+  if (result != SUCCESS)
+    return result;
+
+  if (isManifest)
+    DeleteChunks(service, account, manifest.generation, manifest.chunkCount);
+
+  return SUCCESS;
+}
+
+}  // namespace keytar
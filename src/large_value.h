@@ -0,0 +1,43 @@
+#ifndef SRC_LARGE_VALUE_H_
+#define SRC_LARGE_VALUE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// Largest value SetLargePassword stores, and largest length GetLargePassword
+// accepts from a stored manifest.
+const uint64_t kMaxLargeValueSize = 256 * 1024 * 1024;
+
+// Default size above which large values are deflated before being stored.
+const size_t kDefaultCompressThreshold = 1024;
+
+// Stores `password` under (service, account), deflating it when it is at
+// least `compressThreshold` bytes and splitting it across linked chunk items
+// when it still doesn't fit into a single keychain entry. The manifest entry
+// is written last, so readers always see either the old or the new value.
+KEYTAR_OP_RESULT SetLargePassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& password,
+                                  size_t compressThreshold,
+                                  std::string* error);
+
+// Reads a value written by SetLargePassword and reassembles its chunks.
+// Values stored through the regular API are returned unchanged.
+KEYTAR_OP_RESULT GetLargePassword(const std::string& service,
+                                  const std::string& account,
+                                  std::string* password,
+                                  std::string* error);
+
+// Deletes the manifest entry and every chunk it links to.
+KEYTAR_OP_RESULT DeleteLargePassword(const std::string& service,
+                                     const std::string& account,
+                                     std::string* error);
+
+}  // namespace keytar
+
+#endif  // SRC_LARGE_VALUE_H_
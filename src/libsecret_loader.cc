@@ -0,0 +1,57 @@
+#include "libsecret_loader.h"
+
+#include <dlfcn.h>
+
+#include <mutex>
+#include <string>
+
+namespace keytar {
+
+#define KEYTAR_DEFINE_LIBSECRET_FUNCTION(name) decltype(&::name) name = NULL;
+KEYTAR_LIBSECRET_FUNCTIONS(KEYTAR_DEFINE_LIBSECRET_FUNCTION)
+#undef KEYTAR_DEFINE_LIBSECRET_FUNCTION
+
+namespace {
+
+const char kLibsecretName[] = "libsecret-1.so.0";
+
+std::once_flag loadOnce;
+bool loaded = false;
+std::string loadError;
+
+void Load() {
+  // The handle is never closed: GLib can't be safely unloaded.
+  void* handle = dlopen(kLibsecretName, RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    // Deliberately no automatic fallback: keyctl keys only live in kernel
+    // memory, so silently storing secrets there would lose them on reboot.
+    loadError = std::string("Cannot use the Secret Service: ") + dlerror() +
+                ". Install libsecret (for example the libsecret-1-0 package) "
+                "or select the keyctl backend with "
+                "configure({backend: 'keyctl'}) or KEYTAR_BACKEND=keyctl.";
+    return;
+  }
+
+#define KEYTAR_RESOLVE_LIBSECRET_FUNCTION(name)                       \
+  name = reinterpret_cast<decltype(name)>(dlsym(handle, #name));      \
+  if (name == NULL) {                                                 \
+    loadError = std::string("Cannot use the Secret Service: ") +      \
+                kLibsecretName + " does not provide " #name;          \
+    return;                                                           \
+  }
+  KEYTAR_LIBSECRET_FUNCTIONS(KEYTAR_RESOLVE_LIBSECRET_FUNCTION)
+#undef KEYTAR_RESOLVE_LIBSECRET_FUNCTION
+
+  loaded = true;
+}
+
+}  // namespace
+
+bool LoadLibsecret(std::string* error) {
+  std::call_once(loadOnce, Load);
+  if (!loaded)
+    *error = loadError;
+  return loaded;
+}
+
+}  // namespace keytar
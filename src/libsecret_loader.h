@@ -0,0 +1,81 @@
+#ifndef SRC_LIBSECRET_LOADER_H_
+#define SRC_LIBSECRET_LOADER_H_
+
+#include <string>
+
+// This is needed to make the builds on Ubuntu 14.04 / libsecret v0.16 work.
+// The API we use has already stabilized.
+#define SECRET_API_SUBJECT_TO_CHANGE
+#include <libsecret/secret.h>
+
+// Every libsecret, GIO and GLib function keytar_posix.cc calls. They are
+// resolved from libsecret-1.so.0 (and the GLib libraries it pulls in) on
+// first use, so loading keytar neither needs libsecret to be installed nor
+// pays for GLib's initialization until a secret is actually accessed.
+#define KEYTAR_LIBSECRET_FUNCTIONS(X)             \
+  X(g_clear_error)                                \
+  X(g_dbus_proxy_get_object_path)                 \
+  X(g_error_free)                                 \
+  X(g_free)                                       \
+  X(g_hash_table_destroy)                         \
+  X(g_hash_table_lookup)                          \
+  X(g_hash_table_new)                             \
+  X(g_hash_table_replace)                         \
+  X(g_hash_table_unref)                           \
+  X(g_list_append)                                \
+  X(g_list_free_full)                             \
+  X(g_list_length)                                \
+  X(g_object_ref)                                 \
+  X(g_object_unref)                               \
+  X(g_str_equal)                                  \
+  X(g_str_hash)                                   \
+  X(g_strfreev)                                   \
+  X(secret_collection_for_alias_sync)             \
+  X(secret_collection_get_label)                  \
+  X(secret_collection_get_locked)                 \
+  X(secret_collection_new_for_dbus_path_sync)     \
+  X(secret_collection_search_sync)                \
+  X(secret_item_delete_sync)                      \
+  X(secret_item_get_attributes)                   \
+  X(secret_item_get_created)                      \
+  X(secret_item_get_locked)                       \
+  X(secret_item_get_modified)                     \
+  X(secret_item_get_secret)                       \
+  X(secret_item_new_for_dbus_path_sync)           \
+  X(secret_item_set_secret_sync)                  \
+  X(secret_password_clear_sync)                   \
+  X(secret_password_free)                         \
+  X(secret_password_lookup_sync)                  \
+  X(secret_password_store_sync)                   \
+  X(secret_service_delete_item_dbus_path_sync)    \
+  X(secret_service_disconnect)                    \
+  X(secret_service_get_collections)               \
+  X(secret_service_get_secret_for_dbus_path_sync) \
+  X(secret_service_get_sync)                      \
+  X(secret_service_load_collections_sync)         \
+  X(secret_service_search_for_dbus_paths_sync)    \
+  X(secret_service_search_sync)                   \
+  X(secret_service_store_sync)                    \
+  X(secret_service_unlock_dbus_paths_sync)        \
+  X(secret_service_unlock_sync)                   \
+  X(secret_value_get)                             \
+  X(secret_value_get_text)                        \
+  X(secret_value_new)                             \
+  X(secret_value_unref)
+
+namespace keytar {
+
+// Pointers named after the functions they resolve to. Inside namespace
+// keytar they hide the global declarations, so unqualified calls go through
+// them.
+#define KEYTAR_DECLARE_LIBSECRET_FUNCTION(name) extern decltype(&::name) name;
+KEYTAR_LIBSECRET_FUNCTIONS(KEYTAR_DECLARE_LIBSECRET_FUNCTION)
+#undef KEYTAR_DECLARE_LIBSECRET_FUNCTION
+
+// Loads libsecret and resolves the pointers above, once per process.
+// Returns false with a description of what is missing when that fails.
+bool LoadLibsecret(std::string* error);
+
+}  // namespace keytar
+
+#endif  // SRC_LIBSECRET_LOADER_H_
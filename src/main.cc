@@ -1,23 +1,76 @@
 #include "nan.h"
 #include "async.h"
+#include "credential_handle.h"
+#include "preload.h"
+#include "probes.h"
+#include "secret_fd.h"
+#include "transfer_cursor.h"
+
+#include <openssl/crypto.h>
 
 namespace {
 
+// Copies a string (as UTF-8) or Buffer argument into a byte string.
+std::string ToBytes(v8::Local<v8::Value> value) {
+  if (node::Buffer::HasInstance(value)) {
+    return std::string(node::Buffer::Data(value), node::Buffer::Length(value));
+  }
+  return *v8::String::Utf8Value(value);
+}
+
 NAN_METHOD(SetPassword) {
   SetPasswordWorker* worker = new SetPasswordWorker(
     *v8::String::Utf8Value(info[0]),
     *v8::String::Utf8Value(info[1]),
     *v8::String::Utf8Value(info[2]),
     new Nan::Callback(info[3].As<v8::Function>()));
-  Nan::AsyncQueueWorker(worker);
+  worker->Queue();
 }
 
 NAN_METHOD(GetPassword) {
+  std::string service = *v8::String::Utf8Value(info[0]);
+  std::string account = *v8::String::Utf8Value(info[1]);
+  std::string password;
+  bool found;
+  if (keytar::LookupPreloaded(service, account, false, &password, &found)) {
+    CallWithPreloaded(info[2], found, password, false);
+    return;
+  }
+
   GetPasswordWorker* worker = new GetPasswordWorker(
+    service,
+    account,
+    new Nan::Callback(info[2].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(SetPasswordBuffer) {
+  v8::Local<v8::Object> buffer = info[2].As<v8::Object>();
+  SetPasswordWorker* worker = new SetPasswordWorker(
     *v8::String::Utf8Value(info[0]),
     *v8::String::Utf8Value(info[1]),
-    new Nan::Callback(info[2].As<v8::Function>()));
-  Nan::AsyncQueueWorker(worker);
+    std::string(node::Buffer::Data(buffer), node::Buffer::Length(buffer)),
+    new Nan::Callback(info[3].As<v8::Function>()),
+    true);
+  worker->Queue();
+}
+
+NAN_METHOD(GetPasswordBuffer) {
+  std::string service = *v8::String::Utf8Value(info[0]);
+  std::string account = *v8::String::Utf8Value(info[1]);
+  std::string password;
+  bool found;
+  if (keytar::LookupPreloaded(service, account, true, &password, &found)) {
+    CallWithPreloaded(info[2], found, password, true);
+    return;
+  }
+
+  GetPasswordWorker* worker = new GetPasswordWorker(
+    service,
+    account,
+    new Nan::Callback(info[2].As<v8::Function>()),
+    true);
+  worker->Queue();
 }
 
 NAN_METHOD(DeletePassword) {
@@ -25,29 +78,295 @@ NAN_METHOD(DeletePassword) {
     *v8::String::Utf8Value(info[0]),
     *v8::String::Utf8Value(info[1]),
     new Nan::Callback(info[2].As<v8::Function>()));
-  Nan::AsyncQueueWorker(worker);
+  worker->Queue();
 }
 
 NAN_METHOD(FindPassword) {
+  std::string service = *v8::String::Utf8Value(info[0]);
+  std::string password;
+  bool found;
+  if (keytar::FindPreloaded(service, &password, &found)) {
+    CallWithPreloaded(info[1], found, password, false);
+    return;
+  }
+
   FindPasswordWorker* worker = new FindPasswordWorker(
-    *v8::String::Utf8Value(info[0]),
+    service,
     new Nan::Callback(info[1].As<v8::Function>()));
-  Nan::AsyncQueueWorker(worker);
+  worker->Queue();
 }
 
 NAN_METHOD(FindCredentials) {
   FindCredentialsWorker* worker = new FindCredentialsWorker(
+    *v8::String::Utf8Value(info[0]),
+    new Nan::Callback(info[2].As<v8::Function>()),
+    std::vector<std::string>(),
+    Nan::To<bool>(info[1]).FromJust());
+  worker->Queue();
+}
+
+NAN_METHOD(FindCredentialsSince) {
+  FindCredentialsSinceWorker* worker = new FindCredentialsSinceWorker(
+    *v8::String::Utf8Value(info[0]),
+    Nan::To<int64_t>(info[1]).FromJust(),
+    new Nan::Callback(info[2].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(SetLargePassword) {
+  SetLargePasswordWorker* worker = new SetLargePasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    ToBytes(info[2]),
+    Nan::To<uint32_t>(info[3]).FromJust(),
+    new Nan::Callback(info[4].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(GetLargePassword) {
+  GetLargePasswordWorker* worker = new GetLargePasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    new Nan::Callback(info[3].As<v8::Function>()),
+    Nan::To<bool>(info[2]).FromJust());
+  worker->Queue();
+}
+
+NAN_METHOD(DeleteLargePassword) {
+  DeleteLargePasswordWorker* worker = new DeleteLargePasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    new Nan::Callback(info[2].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(SetPasswordConditional) {
+  bool hasExpected = !info[5]->IsNull() && !info[5]->IsUndefined();
+  ConditionalSetPasswordWorker* worker = new ConditionalSetPasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    ToBytes(info[2]),
+    Nan::To<bool>(info[3]).FromJust(),
+    Nan::To<bool>(info[4]).FromJust(),
+    hasExpected,
+    hasExpected ? ToBytes(info[5]) : std::string(),
+    new Nan::Callback(info[6].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(GetOrSetPassword) {
+  GetOrSetPasswordWorker* worker = new GetOrSetPasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    ToBytes(info[2]),
+    Nan::To<bool>(info[3]).FromJust(),
+    new Nan::Callback(info[4].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(ReplacePassword) {
+  ReplacePasswordWorker* worker = new ReplacePasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    ToBytes(info[2]),
+    Nan::To<bool>(info[3]).FromJust(),
+    new Nan::Callback(info[4].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(DeleteCredentials) {
+  DeleteCredentialsWorker* worker = new DeleteCredentialsWorker(
     *v8::String::Utf8Value(info[0]),
     new Nan::Callback(info[1].As<v8::Function>()));
-  Nan::AsyncQueueWorker(worker);
+  worker->Queue();
+}
+
+NAN_METHOD(SetPasswordInCollection) {
+  SetPasswordWorker* worker = new SetPasswordWorker(
+    *v8::String::Utf8Value(info[1]),
+    *v8::String::Utf8Value(info[2]),
+    ToBytes(info[3]),
+    new Nan::Callback(info[5].As<v8::Function>()),
+    Nan::To<bool>(info[4]).FromJust(),
+    *v8::String::Utf8Value(info[0]));
+  worker->Queue();
+}
+
+NAN_METHOD(SetPasswordWithTimeout) {
+  SetPasswordWorker* worker = new SetPasswordWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    ToBytes(info[2]),
+    new Nan::Callback(info[5].As<v8::Function>()),
+    Nan::To<bool>(info[3]).FromJust(),
+    std::string(),
+    Nan::To<uint32_t>(info[4]).FromJust());
+  worker->Queue();
+}
+
+NAN_METHOD(GetPasswordInCollection) {
+  GetPasswordWorker* worker = new GetPasswordWorker(
+    *v8::String::Utf8Value(info[1]),
+    *v8::String::Utf8Value(info[2]),
+    new Nan::Callback(info[4].As<v8::Function>()),
+    Nan::To<bool>(info[3]).FromJust(),
+    *v8::String::Utf8Value(info[0]));
+  worker->Queue();
+}
+
+NAN_METHOD(DeletePasswordInCollection) {
+  DeletePasswordWorker* worker = new DeletePasswordWorker(
+    *v8::String::Utf8Value(info[1]),
+    *v8::String::Utf8Value(info[2]),
+    new Nan::Callback(info[3].As<v8::Function>()),
+    *v8::String::Utf8Value(info[0]));
+  worker->Queue();
+}
+
+NAN_METHOD(FindPasswordInCollection) {
+  FindPasswordWorker* worker = new FindPasswordWorker(
+    *v8::String::Utf8Value(info[1]),
+    new Nan::Callback(info[2].As<v8::Function>()),
+    *v8::String::Utf8Value(info[0]));
+  worker->Queue();
+}
+
+NAN_METHOD(FindCredentialsInCollections) {
+  v8::Local<v8::Array> names = info[0].As<v8::Array>();
+  std::vector<std::string> collections;
+  for (uint32_t i = 0; i < names->Length(); ++i) {
+    collections.push_back(
+      *v8::String::Utf8Value(Nan::Get(names, i).ToLocalChecked()));
+  }
+  FindCredentialsWorker* worker = new FindCredentialsWorker(
+    *v8::String::Utf8Value(info[1]),
+    new Nan::Callback(info[3].As<v8::Function>()),
+    collections,
+    Nan::To<bool>(info[2]).FromJust());
+  worker->Queue();
+}
+
+NAN_METHOD(Preload) {
+  v8::Local<v8::Array> names = info[0].As<v8::Array>();
+  std::vector<std::string> services;
+  for (uint32_t i = 0; i < names->Length(); ++i) {
+    services.push_back(
+      *v8::String::Utf8Value(Nan::Get(names, i).ToLocalChecked()));
+  }
+  PreloadWorker* worker = new PreloadWorker(
+    services,
+    new Nan::Callback(info[1].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(ExportToFd) {
+  ExportToFdWorker* worker = new ExportToFdWorker(
+    *v8::String::Utf8Value(info[0]),
+    *v8::String::Utf8Value(info[1]),
+    new Nan::Callback(info[2].As<v8::Function>()));
+  worker->Queue();
+}
+
+// Synchronous: the file is already in memory, so this is one mmap.
+NAN_METHOD(ReadFromFd) {
+  std::string secret;
+  std::string error;
+  if (keytar::ReadSecretFd(Nan::To<int32_t>(info[0]).FromJust(), &secret,
+                           &error) != keytar::SUCCESS) {
+    Nan::ThrowError(error.c_str());
+    return;
+  }
+  if (Nan::To<bool>(info[1]).FromJust()) {
+    info.GetReturnValue().Set(
+      Nan::CopyBuffer(secret.data(), secret.length()).ToLocalChecked());
+  } else {
+    info.GetReturnValue().Set(
+      Nan::New<v8::String>(secret.data(), secret.length()).ToLocalChecked());
+  }
+  if (!secret.empty())
+    OPENSSL_cleanse(&secret[0], secret.size());
+}
+
+NAN_METHOD(SetInteractive) {
+  keytar::SetInteractive(Nan::To<bool>(info[0]).FromJust());
+}
+
+NAN_METHOD(Unlock) {
+  v8::Local<v8::Array> names = info[0].As<v8::Array>();
+  std::vector<std::string> collections;
+  for (uint32_t i = 0; i < names->Length(); ++i) {
+    collections.push_back(
+      *v8::String::Utf8Value(Nan::Get(names, i).ToLocalChecked()));
+  }
+  UnlockWorker* worker = new UnlockWorker(
+    collections,
+    new Nan::Callback(info[1].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(SetIdleTimeout) {
+  keytar::SetIdleTimeout(Nan::To<uint32_t>(info[0]).FromJust());
+}
+
+NAN_METHOD(Release) {
+  ReleaseWorker* worker = new ReleaseWorker(
+    new Nan::Callback(info[0].As<v8::Function>()));
+  worker->Queue();
+}
+
+NAN_METHOD(ConfigureBackend) {
+  keytar::BackendOptions options;
+  options.name = *v8::String::Utf8Value(info[0]);
+  options.keyring = *v8::String::Utf8Value(info[1]);
+  options.timeout = Nan::To<uint32_t>(info[2]).FromJust();
+
+  std::string error;
+  if (keytar::ConfigureBackend(options, &error) != keytar::SUCCESS) {
+    Nan::ThrowError(error.c_str());
+    return;
+  }
+  // Entries read from the previous backend must not answer for this one.
+  keytar::InvalidateAllPreloaded();
 }
 
 void Init(v8::Handle<v8::Object> exports) {
   Nan::SetMethod(exports, "getPassword", GetPassword);
   Nan::SetMethod(exports, "setPassword", SetPassword);
+  Nan::SetMethod(exports, "getPasswordBuffer", GetPasswordBuffer);
+  Nan::SetMethod(exports, "setPasswordBuffer", SetPasswordBuffer);
   Nan::SetMethod(exports, "deletePassword", DeletePassword);
   Nan::SetMethod(exports, "findPassword", FindPassword);
   Nan::SetMethod(exports, "findCredentials", FindCredentials);
+  Nan::SetMethod(exports, "findCredentialsSince", FindCredentialsSince);
+  Nan::SetMethod(exports, "setLargePassword", SetLargePassword);
+  Nan::SetMethod(exports, "getLargePassword", GetLargePassword);
+  Nan::SetMethod(exports, "deleteLargePassword", DeleteLargePassword);
+  Nan::SetMethod(exports, "setPasswordConditional", SetPasswordConditional);
+  Nan::SetMethod(exports, "getOrSetPassword", GetOrSetPassword);
+  Nan::SetMethod(exports, "replacePassword", ReplacePassword);
+  Nan::SetMethod(exports, "deleteCredentials", DeleteCredentials);
+  Nan::SetMethod(exports, "setPasswordInCollection", SetPasswordInCollection);
+  Nan::SetMethod(exports, "setPasswordWithTimeout", SetPasswordWithTimeout);
+  Nan::SetMethod(exports, "getPasswordInCollection", GetPasswordInCollection);
+  Nan::SetMethod(exports, "deletePasswordInCollection", DeletePasswordInCollection);
+  Nan::SetMethod(exports, "findPasswordInCollection", FindPasswordInCollection);
+  Nan::SetMethod(exports, "findCredentialsInCollections", FindCredentialsInCollections);
+  Nan::SetMethod(exports, "preload", Preload);
+  Nan::SetMethod(exports, "exportToFd", ExportToFd);
+  Nan::SetMethod(exports, "readFromFd", ReadFromFd);
+  Nan::SetMethod(exports, "configureBackend", ConfigureBackend);
+  Nan::SetMethod(exports, "setIdleTimeout", SetIdleTimeout);
+  Nan::SetMethod(exports, "setInteractive", SetInteractive);
+  Nan::SetMethod(exports, "unlock", Unlock);
+  Nan::SetMethod(exports, "release", Release);
+#ifdef KEYTAR_HAVE_PROBES
+  Nan::Set(exports, Nan::New("probes").ToLocalChecked(), Nan::True());
+#else
+  Nan::Set(exports, Nan::New("probes").ToLocalChecked(), Nan::False());
+#endif
+  CredentialHandle::Init(exports);
+  ExportCursor::Init(exports);
+  ImportCursor::Init(exports);
 }
 
 }  // namespace
@@ -0,0 +1,196 @@
+#include "native_async.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace keytar {
+
+namespace {
+
+const size_t kDefaultExecutorThreads = 4;
+
+// Fixed-size thread pool draining a FIFO of tasks. Threads are started on
+// the first submission and run until the process exits.
+class Executor {
+  public:
+    explicit Executor(size_t threads) {
+      for (size_t i = 0; i < threads; ++i) {
+        std::thread(&Executor::Run, this).detach();
+      }
+    }
+
+    void Submit(std::function<void()> task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+      }
+      ready.notify_one();
+    }
+
+  private:
+    void Run() {
+      for (;;) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (tasks.empty()) {
+            ready.wait(lock);
+          }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+        task();
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()> > tasks;
+};
+
+std::mutex executorMutex;
+size_t executorThreads = kDefaultExecutorThreads;
+
+// Deliberately leaked, like the Secret Service connection in
+// keytar_posix.cc: destroying it at exit would wait for threads stuck in a
+// backend call, or let queued tasks run after the statics they use are gone.
+Executor* GetExecutor() {
+  static Executor* executor = NULL;
+  std::lock_guard<std::mutex> lock(executorMutex);
+  if (executor == NULL)
+    executor = new Executor(executorThreads);
+  return executor;
+}
+
+// Runs `op` on the executor and hands its result to `done`.
+template <typename Result>
+void Dispatch(std::function<Result()> op,
+              std::function<void(const Result&)> done) {
+  GetExecutor()->Submit([op, done]() {
+    done(op());
+  });
+}
+
+// Runs `op` on the executor and returns a future for its result.
+template <typename Result>
+std::future<Result> Dispatch(std::function<Result()> op) {
+  std::shared_ptr<std::promise<Result> > promise =
+    std::make_shared<std::promise<Result> >();
+  std::future<Result> future = promise->get_future();
+  GetExecutor()->Submit([op, promise]() {
+    promise->set_value(op());
+  });
+  return future;
+}
+
+std::function<OpResult()> SetPasswordOp(const std::string& service,
+                                        const std::string& account,
+                                        const std::string& password) {
+  return [service, account, password]() {
+    OpResult out;
+    out.result = SetPassword(service, account, password, &out.error);
+    return out;
+  };
+}
+
+std::function<PasswordResult()> GetPasswordOp(const std::string& service,
+                                              const std::string& account) {
+  return [service, account]() {
+    PasswordResult out;
+    out.result = GetPassword(service, account, &out.password, &out.error);
+    return out;
+  };
+}
+
+std::function<OpResult()> DeletePasswordOp(const std::string& service,
+                                           const std::string& account) {
+  return [service, account]() {
+    OpResult out;
+    out.result = DeletePassword(service, account, &out.error);
+    return out;
+  };
+}
+
+std::function<PasswordResult()> FindPasswordOp(const std::string& service) {
+  return [service]() {
+    PasswordResult out;
+    out.result = FindPassword(service, &out.password, &out.error);
+    return out;
+  };
+}
+
+std::function<CredentialsResult()> FindCredentialsOp(
+    const std::string& service) {
+  return [service]() {
+    CredentialsResult out;
+    out.result = FindCredentials(service, &out.credentials, &out.error);
+    return out;
+  };
+}
+
+}  // namespace
+
+void SetExecutorThreads(size_t count) {
+  std::lock_guard<std::mutex> lock(executorMutex);
+  executorThreads = count > 0 ? count : 1;
+}
+
+std::future<OpResult> SetPasswordAsync(const std::string& service,
+                                       const std::string& account,
+                                       const std::string& password) {
+  return Dispatch(SetPasswordOp(service, account, password));
+}
+
+std::future<PasswordResult> GetPasswordAsync(const std::string& service,
+                                             const std::string& account) {
+  return Dispatch(GetPasswordOp(service, account));
+}
+
+std::future<OpResult> DeletePasswordAsync(const std::string& service,
+                                          const std::string& account) {
+  return Dispatch(DeletePasswordOp(service, account));
+}
+
+std::future<PasswordResult> FindPasswordAsync(const std::string& service) {
+  return Dispatch(FindPasswordOp(service));
+}
+
+std::future<CredentialsResult> FindCredentialsAsync(
+    const std::string& service) {
+  return Dispatch(FindCredentialsOp(service));
+}
+
+void SetPasswordAsync(const std::string& service,
+                      const std::string& account,
+                      const std::string& password,
+                      std::function<void(const OpResult&)> done) {
+  Dispatch(SetPasswordOp(service, account, password), done);
+}
+
+void GetPasswordAsync(const std::string& service,
+                      const std::string& account,
+                      std::function<void(const PasswordResult&)> done) {
+  Dispatch(GetPasswordOp(service, account), done);
+}
+
+void DeletePasswordAsync(const std::string& service,
+                         const std::string& account,
+                         std::function<void(const OpResult&)> done) {
+  Dispatch(DeletePasswordOp(service, account), done);
+}
+
+void FindPasswordAsync(const std::string& service,
+                       std::function<void(const PasswordResult&)> done) {
+  Dispatch(FindPasswordOp(service), done);
+}
+
+void FindCredentialsAsync(const std::string& service,
+                          std::function<void(const CredentialsResult&)> done) {
+  Dispatch(FindCredentialsOp(service), done);
+}
+
+}  // namespace keytar
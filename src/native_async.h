@@ -0,0 +1,71 @@
+#ifndef SRC_NATIVE_ASYNC_H_
+#define SRC_NATIVE_ASYNC_H_
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "credentials.h"
+#include "keytar.h"
+
+namespace keytar {
+
+// Asynchronous variants of the keytar.h API for native consumers. Every call
+// is run on an internal executor and completes either through the returned
+// future or by invoking the callback on one of the executor's threads.
+
+struct OpResult {
+  KEYTAR_OP_RESULT result;
+  std::string error;
+};
+
+struct PasswordResult : OpResult {
+  std::string password;
+};
+
+struct CredentialsResult : OpResult {
+  std::vector<Credentials> credentials;
+};
+
+// Sets the number of executor threads. Only effective before the first
+// asynchronous call; defaults to 4.
+void SetExecutorThreads(size_t count);
+
+std::future<OpResult> SetPasswordAsync(const std::string& service,
+                                       const std::string& account,
+                                       const std::string& password);
+
+std::future<PasswordResult> GetPasswordAsync(const std::string& service,
+                                             const std::string& account);
+
+std::future<OpResult> DeletePasswordAsync(const std::string& service,
+                                          const std::string& account);
+
+std::future<PasswordResult> FindPasswordAsync(const std::string& service);
+
+std::future<CredentialsResult> FindCredentialsAsync(
+  const std::string& service);
+
+void SetPasswordAsync(const std::string& service,
+                      const std::string& account,
+                      const std::string& password,
+                      std::function<void(const OpResult&)> done);
+
+void GetPasswordAsync(const std::string& service,
+                      const std::string& account,
+                      std::function<void(const PasswordResult&)> done);
+
+void DeletePasswordAsync(const std::string& service,
+                         const std::string& account,
+                         std::function<void(const OpResult&)> done);
+
+void FindPasswordAsync(const std::string& service,
+                       std::function<void(const PasswordResult&)> done);
+
+void FindCredentialsAsync(const std::string& service,
+                          std::function<void(const CredentialsResult&)> done);
+
+}  // namespace keytar
+
+#endif  // SRC_NATIVE_ASYNC_H_
@@ -0,0 +1,231 @@
+#include "operations.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace keytar {
+
+namespace {
+
+const size_t kLockStripes = 64;
+std::mutex keyLocks[kLockStripes];
+
+// Most collections searched at once by FindCredentialsInCollections,
+// counting the calling thread.
+const size_t kMaxSearchThreads = 4;
+
+KEYTAR_OP_RESULT Read(const std::string& service,
+                      const std::string& account,
+                      bool binary,
+                      std::string* password,
+                      std::string* error) {
+  if (binary)
+    return GetPasswordBinary(service, account, password, error);
+  return GetPassword(service, account, password, error);
+}
+
+KEYTAR_OP_RESULT Write(const std::string& service,
+                       const std::string& account,
+                       const std::string& password,
+                       bool binary,
+                       std::string* error) {
+  if (binary)
+    return SetPasswordBinary(service, account, password, error);
+  return SetPassword(service, account, password, error);
+}
+
+}  // namespace
+
+std::mutex& LockFor(const std::string& service, const std::string& account) {
+  std::hash<std::string> hash;
+  size_t h = hash(service) * 31 + hash(account);
+  return keyLocks[h % kLockStripes];
+}
+
+KEYTAR_OP_RESULT SetPasswordIfChanged(const std::string& service,
+                                      const std::string& account,
+                                      const std::string& password,
+                                      bool binary,
+                                      bool* written,
+                                      std::string* error) {
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+
+  *written = false;
+  std::string current;
+  KEYTAR_OP_RESULT result = Read(service, account, binary, &current, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+  if (result == SUCCESS && current == password)
+    return SUCCESS;
+
+  result = Write(service, account, password, binary, error);
+  *written = result == SUCCESS;
+  return result;
+}
+
+KEYTAR_OP_RESULT CompareAndSetPassword(const std::string& service,
+                                       const std::string& account,
+                                       const std::string* expected,
+                                       const std::string& password,
+                                       bool binary,
+                                       std::string* error) {
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+
+  std::string current;
+  KEYTAR_OP_RESULT result = Read(service, account, binary, &current, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+
+  bool matches = expected == NULL ?
+    result == FAIL_NONFATAL :
+    result == SUCCESS && current == *expected;
+  if (!matches)
+    return FAIL_NONFATAL;
+
+  return Write(service, account, password, binary, error);
+}
+
+KEYTAR_OP_RESULT GetOrSetPassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& generated,
+                                  bool binary,
+                                  std::string* password,
+                                  bool* created,
+                                  std::string* error) {
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+
+  *created = false;
+  KEYTAR_OP_RESULT result = ExchangePassword(service, account, generated,
+                                             binary, true, password, error);
+  if (result != FAIL_NONFATAL)
+    return result;
+
+  *password = generated;
+  *created = true;
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT ReplacePassword(const std::string& service,
+                                 const std::string& account,
+                                 const std::string& password,
+                                 bool binary,
+                                 std::string* previous,
+                                 bool* hadPrevious,
+                                 std::string* error) {
+  std::lock_guard<std::mutex> lock(LockFor(service, account));
+
+  KEYTAR_OP_RESULT result = ExchangePassword(service, account, password,
+                                             binary, false, previous, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+  *hadPrevious = result == SUCCESS;
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT FindCredentialsInCollections(
+    const std::vector<std::string>& collections,
+    const std::string& service,
+    std::vector<Credentials>* credentials,
+    std::string* error) {
+  size_t count = collections.size();
+  std::vector<std::vector<Credentials> > found(count);
+  std::vector<KEYTAR_OP_RESULT> results(count, SUCCESS);
+  std::vector<std::string> errors(count);
+
+  // A few helper threads and the calling thread take collections in turn
+  // until none are left.
+  std::atomic<size_t> next(0);
+  auto search = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      results[i] = FindCredentialsInCollection(collections[i], service,
+                                               &found[i], &errors[i]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t helpers = std::min(count, kMaxSearchThreads);
+  helpers = helpers > 0 ? helpers - 1 : 0;
+  threads.reserve(helpers);
+  std::string threadError;
+  for (size_t i = 0; i < helpers; ++i) {
+    try {
+      threads.push_back(std::thread(search));
+    } catch (const std::system_error& e) {
+      // Stop the helpers already running from taking more collections.
+      next = count;
+      threadError = e.what();
+      break;
+    }
+  }
+  if (threadError.empty())
+    search();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+
+  if (!threadError.empty()) {
+    *error = "Could not start a search thread: " + threadError;
+    return FAIL_ERROR;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (results[i] == FAIL_ERROR) {
+      *error = collections[i] + ": " + errors[i];
+      return FAIL_ERROR;
+    }
+    // Credentials aren't assignable, so they can't be range-inserted.
+    for (size_t j = 0; j < found[i].size(); ++j)
+      credentials->push_back(found[i][j]);
+  }
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT FindCredentialsSince(const std::string& service,
+                                      int64_t modifiedSince,
+                                      std::vector<Credentials>* changed,
+                                      std::vector<std::string>* accounts,
+                                      int64_t* latest,
+                                      std::string* error) {
+  std::vector<Credentials> credentials;
+  KEYTAR_OP_RESULT result = FindCredentials(service, &credentials, error);
+  if (result == FAIL_ERROR)
+    return FAIL_ERROR;
+
+  *latest = modifiedSince;
+  for (size_t i = 0; i < credentials.size(); ++i) {
+    const Credentials& cred = credentials[i];
+    accounts->push_back(std::get<1>(cred));
+
+    const std::vector<std::pair<std::string, const std::string> >& settings =
+      std::get<2>(cred);
+    bool timestamped = false;
+    int64_t modified = 0;
+    for (size_t j = 0; j < settings.size(); ++j) {
+      if (settings[j].first == "modified") {
+        modified = strtoll(settings[j].second.c_str(), NULL, 10);
+        timestamped = true;
+        break;
+      }
+    }
+
+    // Timestamps have a backend-specific granularity, so an entry modified
+    // within the same tick as `modifiedSince` is reported again rather than
+    // missed.
+    if (!timestamped || modified >= modifiedSince)
+      changed->push_back(cred);
+    if (modified > *latest)
+      *latest = modified;
+  }
+  return SUCCESS;
+}
+
+}  // namespace keytar
@@ -0,0 +1,90 @@
+#ifndef SRC_OPERATIONS_H_
+#define SRC_OPERATIONS_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// Striped locks keyed by (service, account), so read-compare-write sequences
+// on one key don't interleave while unrelated keys proceed in parallel.
+// Held by the operations below and by large-value writes.
+std::mutex& LockFor(const std::string& service, const std::string& account);
+
+// Operations composed from several backend calls that run as one job.
+// Conditional writes on the same (service, account) are serialized within
+// the process, but not against writers in other processes.
+
+// Stores `password` unless the stored value is already byte-for-byte equal
+// to it, so an unchanged value never causes the keyring to be rewritten.
+// `written` reports whether a write happened. `binary` selects the
+// *PasswordBinary flavour of the backend calls.
+KEYTAR_OP_RESULT SetPasswordIfChanged(const std::string& service,
+                                      const std::string& account,
+                                      const std::string& password,
+                                      bool binary,
+                                      bool* written,
+                                      std::string* error);
+
+// Stores `password` only if the stored value equals `*expected`, or, when
+// `expected` is NULL, only if nothing is stored yet. Returns FAIL_NONFATAL
+// without writing when the stored value doesn't match.
+KEYTAR_OP_RESULT CompareAndSetPassword(const std::string& service,
+                                       const std::string& account,
+                                       const std::string* expected,
+                                       const std::string& password,
+                                       bool binary,
+                                       std::string* error);
+
+// Returns the stored value in `password`, or stores `generated` and returns
+// it when nothing is stored yet. `created` reports whether a write happened.
+KEYTAR_OP_RESULT GetOrSetPassword(const std::string& service,
+                                  const std::string& account,
+                                  const std::string& generated,
+                                  bool binary,
+                                  std::string* password,
+                                  bool* created,
+                                  std::string* error);
+
+// Stores `password` and returns the value it replaced in `previous`.
+// `hadPrevious` is false when nothing was stored before.
+KEYTAR_OP_RESULT ReplacePassword(const std::string& service,
+                                 const std::string& account,
+                                 const std::string& password,
+                                 bool binary,
+                                 std::string* previous,
+                                 bool* hadPrevious,
+                                 std::string* error);
+
+// Searches every collection in `collections` for the credentials of
+// `service`, a few at a time, and appends the results in collection order.
+// Fails if any collection fails, naming the collection in `error`, or if a
+// search thread can't be started.
+KEYTAR_OP_RESULT FindCredentialsInCollections(
+    const std::vector<std::string>& collections,
+    const std::string& service,
+    std::vector<Credentials>* credentials,
+    std::string* error);
+
+// Enumerates the credentials of `service` once and returns in `changed`
+// those whose "modified" setting is at or after `modifiedSince`
+// (milliseconds since the Unix epoch), plus every entry the backend doesn't
+// timestamp. `accounts` receives the account of every entry that exists, so
+// callers can tell which previously seen entries were deleted. `latest` is
+// the newest modification time seen, or `modifiedSince` if none is newer.
+// None of the backends keeps a change log, so this is O(entries) per call.
+KEYTAR_OP_RESULT FindCredentialsSince(const std::string& service,
+                                      int64_t modifiedSince,
+                                      std::vector<Credentials>* changed,
+                                      std::vector<std::string>* accounts,
+                                      int64_t* latest,
+                                      std::string* error);
+
+}  // namespace keytar
+
+#endif  // SRC_OPERATIONS_H_
@@ -0,0 +1,93 @@
+#include "packed_credentials.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace keytar {
+
+namespace {
+
+const uint32_t kPackedVersion = 1;
+const size_t kHeaderWords = 4;
+const size_t kEntryWords = 6;
+const size_t kSettingWords = 4;
+
+// Appends strings to the pool, storing each distinct string once.
+class StringPool {
+  public:
+    // Returns the offset of `value` in the pool.
+    uint32_t Add(const std::string& value) {
+      std::unordered_map<std::string, uint32_t>::const_iterator it =
+        offsets.find(value);
+      if (it != offsets.end())
+        return it->second;
+      uint32_t offset = static_cast<uint32_t>(pool.size());
+      pool.append(value);
+      offsets.insert(std::make_pair(value, offset));
+      return offset;
+    }
+
+    const std::string& data() const { return pool; }
+
+  private:
+    std::string pool;
+    std::unordered_map<std::string, uint32_t> offsets;
+};
+
+void PutWord(std::string* out, size_t index, uint32_t value) {
+  char* bytes = &(*out)[index * 4];
+  for (size_t i = 0; i < 4; ++i)
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+}  // namespace
+
+std::string PackCredentials(const std::vector<Credentials>& credentials) {
+  size_t settingCount = 0;
+  for (size_t i = 0; i < credentials.size(); ++i)
+    settingCount += std::get<2>(credentials[i]).size();
+
+  size_t tableWords = kHeaderWords + credentials.size() * kEntryWords +
+                      settingCount * kSettingWords;
+  std::string packed(tableWords * 4, '\0');
+  StringPool pool;
+
+  size_t entry = kHeaderWords;
+  size_t setting = kHeaderWords + credentials.size() * kEntryWords;
+  uint32_t settingIndex = 0;
+  for (size_t i = 0; i < credentials.size(); ++i) {
+    const std::string& server = std::get<0>(credentials[i]);
+    const std::string& account = std::get<1>(credentials[i]);
+    const std::vector<std::pair<std::string, const std::string> >& settings =
+      std::get<2>(credentials[i]);
+
+    PutWord(&packed, entry++, pool.Add(server));
+    PutWord(&packed, entry++, static_cast<uint32_t>(server.size()));
+    PutWord(&packed, entry++, pool.Add(account));
+    PutWord(&packed, entry++, static_cast<uint32_t>(account.size()));
+    PutWord(&packed, entry++, settingIndex);
+    PutWord(&packed, entry++, static_cast<uint32_t>(settings.size()));
+
+    for (size_t j = 0; j < settings.size(); ++j) {
+      PutWord(&packed, setting++, pool.Add(settings[j].first));
+      PutWord(&packed, setting++, static_cast<uint32_t>(settings[j].first.size()));
+      PutWord(&packed, setting++, pool.Add(settings[j].second));
+      PutWord(&packed, setting++, static_cast<uint32_t>(settings[j].second.size()));
+    }
+    settingIndex += static_cast<uint32_t>(settings.size());
+  }
+
+  PutWord(&packed, 0, kPackedVersion);
+  PutWord(&packed, 1, static_cast<uint32_t>(credentials.size()));
+  PutWord(&packed, 2, static_cast<uint32_t>(settingCount));
+  PutWord(&packed, 3, static_cast<uint32_t>(packed.size()));
+  packed.append(pool.data());
+  return packed;
+}
+
+}  // namespace keytar
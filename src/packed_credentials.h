@@ -0,0 +1,25 @@
+#ifndef SRC_PACKED_CREDENTIALS_H_
+#define SRC_PACKED_CREDENTIALS_H_
+
+#include <string>
+#include <vector>
+
+#include "credentials.h"
+
+namespace keytar {
+
+// Packs credentials into one buffer that lib/packed-credentials.js reads
+// without creating an object per entry.
+//
+// Layout, all integers u32 little-endian:
+//   header:   version | entry count | setting count | pool offset
+//   entries:  server offset | server length | account offset |
+//             account length | first setting | setting count
+//   settings: name offset | name length | value offset | value length
+//   pool:     UTF-8 strings; offsets above are relative to its start
+// Equal strings, such as the server of every entry, are stored once.
+std::string PackCredentials(const std::vector<Credentials>& credentials);
+
+}  // namespace keytar
+
+#endif  // SRC_PACKED_CREDENTIALS_H_
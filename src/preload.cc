@@ -0,0 +1,171 @@
+#include "preload.h"
+
+#include <stdint.h>
+
+#include <openssl/crypto.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace keytar {
+
+namespace {
+
+struct PreloadedService {
+  PreloadedService() : generation(0), complete(false) {}
+
+  // Bumped when a Preload starts and on service-wide invalidation. A Preload
+  // only installs what it read if no other Preload or invalidation started
+  // in the meantime.
+  uint64_t generation;
+  // Whether `entries` holds every entry of the service, so that a missing
+  // account means there is no such entry.
+  bool complete;
+  std::map<std::string, StoredSecret> entries;
+  // Accounts written since `entries` were read, which the cache must not
+  // answer for.
+  std::set<std::string> stale;
+  // Accounts written since the running Preload started. They become
+  // `stale` when it installs its entries.
+  std::set<std::string> pendingStale;
+};
+
+std::mutex preloadLock;
+std::map<std::string, PreloadedService> preloaded;
+
+void Wipe(std::string* value) {
+  if (!value->empty())
+    OPENSSL_cleanse(&(*value)[0], value->size());
+}
+
+void WipeEntries(std::map<std::string, StoredSecret>* entries) {
+  std::map<std::string, StoredSecret>::iterator it;
+  for (it = entries->begin(); it != entries->end(); ++it)
+    Wipe(&it->second.secret);
+  entries->clear();
+}
+
+void Invalidate(PreloadedService* cached) {
+  ++cached->generation;
+  cached->complete = false;
+  WipeEntries(&cached->entries);
+  cached->stale.clear();
+  cached->pendingStale.clear();
+}
+
+}  // namespace
+
+KEYTAR_OP_RESULT Preload(const std::string& service,
+                         size_t* count,
+                         std::string* error) {
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(preloadLock);
+    PreloadedService& cached = preloaded[service];
+    generation = ++cached.generation;
+    cached.pendingStale.clear();
+  }
+
+  std::vector<StoredSecret> secrets;
+  KEYTAR_OP_RESULT result = FindSecrets(service, &secrets, error);
+
+  if (result != FAIL_ERROR) {
+    std::lock_guard<std::mutex> lock(preloadLock);
+    PreloadedService& cached = preloaded[service];
+    if (cached.generation == generation) {
+      WipeEntries(&cached.entries);
+      // Like a lookup, keep the first entry found for an account.
+      for (size_t i = 0; i < secrets.size(); ++i)
+        cached.entries.insert(std::make_pair(secrets[i].account, secrets[i]));
+      cached.stale.swap(cached.pendingStale);
+      cached.pendingStale.clear();
+      cached.complete = true;
+    }
+    *count = secrets.size();
+  }
+
+  for (size_t i = 0; i < secrets.size(); ++i)
+    Wipe(&secrets[i].secret);
+  return result == FAIL_ERROR ? FAIL_ERROR : SUCCESS;
+}
+
+bool LookupPreloaded(const std::string& service,
+                     const std::string& account,
+                     bool binary,
+                     std::string* password,
+                     bool* found) {
+  std::lock_guard<std::mutex> lock(preloadLock);
+  std::map<std::string, PreloadedService>::const_iterator it =
+    preloaded.find(service);
+  if (it == preloaded.end() || !it->second.complete ||
+      it->second.stale.count(account) > 0)
+    return false;
+
+  std::map<std::string, StoredSecret>::const_iterator entry =
+    it->second.entries.find(account);
+  // The text API treats secrets that aren't text as missing.
+  *found = entry != it->second.entries.end() &&
+           (binary || entry->second.text);
+  if (*found)
+    *password = entry->second.secret;
+  return true;
+}
+
+bool FindPreloaded(const std::string& service,
+                   std::string* password,
+                   bool* found) {
+  std::lock_guard<std::mutex> lock(preloadLock);
+  std::map<std::string, PreloadedService>::const_iterator it =
+    preloaded.find(service);
+  if (it == preloaded.end() || !it->second.complete)
+    return false;
+
+  const PreloadedService& cached = it->second;
+  std::map<std::string, StoredSecret>::const_iterator entry;
+  for (entry = cached.entries.begin(); entry != cached.entries.end();
+       ++entry) {
+    if (entry->second.text && cached.stale.count(entry->first) == 0) {
+      *password = entry->second.secret;
+      *found = true;
+      return true;
+    }
+  }
+
+  // A written account might now hold the only password of the service.
+  if (!cached.stale.empty())
+    return false;
+  *found = false;
+  return true;
+}
+
+void InvalidatePreloaded(const std::string& service,
+                         const std::string& account) {
+  std::lock_guard<std::mutex> lock(preloadLock);
+  std::map<std::string, PreloadedService>::iterator it =
+    preloaded.find(service);
+  if (it == preloaded.end())
+    return;
+  it->second.stale.insert(account);
+  it->second.pendingStale.insert(account);
+}
+
+void InvalidatePreloaded(const std::string& service) {
+  std::lock_guard<std::mutex> lock(preloadLock);
+  std::map<std::string, PreloadedService>::iterator it =
+    preloaded.find(service);
+  if (it == preloaded.end())
+    return;
+  Invalidate(&it->second);
+}
+
+void InvalidateAllPreloaded() {
+  std::lock_guard<std::mutex> lock(preloadLock);
+  std::map<std::string, PreloadedService>::iterator it;
+  for (it = preloaded.begin(); it != preloaded.end(); ++it)
+    Invalidate(&it->second);
+}
+
+}  // namespace keytar
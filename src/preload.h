@@ -0,0 +1,49 @@
+#ifndef SRC_PRELOAD_H_
+#define SRC_PRELOAD_H_
+
+#include <string>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// In-process copy of the entries of preloaded services, so reads at startup
+// don't each cost a keyring round trip. Only this process's writes
+// invalidate it; changes made by other processes are seen after the next
+// Preload of the service.
+
+// Fetches every entry of `service` with one backend search and replaces the
+// cached copy of the service with them. `count` receives the number of
+// entries loaded.
+KEYTAR_OP_RESULT Preload(const std::string& service,
+                         size_t* count,
+                         std::string* error);
+
+// Answers GetPassword (or GetPasswordBinary when `binary` is set) from the
+// cache. Returns false when the cache can't answer, otherwise sets `found`
+// and, when it is true, `password`.
+bool LookupPreloaded(const std::string& service,
+                     const std::string& account,
+                     bool binary,
+                     std::string* password,
+                     bool* found);
+
+// Answers FindPassword from the cache, like LookupPreloaded.
+bool FindPreloaded(const std::string& service,
+                   std::string* password,
+                   bool* found);
+
+// Stops answering for `account` until the service is preloaded again. Call
+// after every write, once the backend call has returned.
+void InvalidatePreloaded(const std::string& service,
+                         const std::string& account);
+
+// Stops answering for every account of `service`.
+void InvalidatePreloaded(const std::string& service);
+
+// Stops answering for every service, for example when the backend changes.
+void InvalidateAllPreloaded();
+
+}  // namespace keytar
+
+#endif  // SRC_PRELOAD_H_
@@ -0,0 +1,61 @@
+#ifndef SRC_PROBES_H_
+#define SRC_PROBES_H_
+
+// USDT probes under the "keytar" provider, for tracing with bpftrace, perf
+// or SystemTap. Each probe site is a single nop until a tracer attaches.
+// Built when KEYTAR_ENABLE_PROBES is defined (the keytar_probes gyp
+// variable) and <sys/sdt.h> is available.
+//
+//   worker__enqueue(const char* op)        a JS call queued its worker
+//   execute__start(const char* op)         the worker started on the pool
+//   execute__done(const char* op, int r)   ... and finished with result r
+//   backend__start(const char* op)         a keyring backend call started
+//   backend__done(const char* op)          ... and returned
+//   callback__start(const char* op)        results are being passed to JS
+//   callback__done(const char* op)         ... and the callback returned
+//
+// `r` is a KEYTAR_OP_RESULT: 0 success, 1 error, 2 not found or no change.
+// For example:
+//
+//   bpftrace -e 'usdt:./build/Release/keytar.node:keytar:execute__done
+//                { @[str(arg0), arg1] = count(); }'
+
+#if defined(KEYTAR_ENABLE_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define KEYTAR_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef KEYTAR_HAVE_PROBES
+#define KEYTAR_PROBE1(name, a) DTRACE_PROBE1(keytar, name, a)
+#define KEYTAR_PROBE2(name, a, b) DTRACE_PROBE2(keytar, name, a, b)
+#else
+#define KEYTAR_PROBE1(name, a) do {} while (0)
+#define KEYTAR_PROBE2(name, a, b) do {} while (0)
+#endif
+
+namespace keytar {
+
+// Fires backend__start on construction and backend__done when the scope
+// ends, however the backend function returns.
+class BackendProbe {
+  public:
+    explicit BackendProbe(const char* operation) : operation(operation) {
+      KEYTAR_PROBE1(backend__start, operation);
+    }
+
+    ~BackendProbe() {
+      KEYTAR_PROBE1(backend__done, operation);
+    }
+
+  private:
+    BackendProbe(const BackendProbe&);
+    BackendProbe& operator=(const BackendProbe&);
+
+    const char* const operation;
+};
+
+}  // namespace keytar
+
+#endif  // SRC_PROBES_H_
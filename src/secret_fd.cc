@@ -0,0 +1,142 @@
+#include "secret_fd.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+
+namespace keytar {
+
+#ifdef __linux__
+
+namespace {
+
+const char kMemfdName[] = "keytar-secret";
+
+KEYTAR_OP_RESULT SystemError(const char* call, std::string* error) {
+  *error = std::string(call) + " failed: " + strerror(errno);
+  return FAIL_ERROR;
+}
+
+// Returns a memfd_secret(2) file holding `secret`, or -1 when the kernel
+// doesn't offer secret memory (it is off by default before Linux 6.5) or
+// the locked-memory limit is too low for it.
+int CreateSecretMemory(const std::string& secret) {
+#ifdef SYS_memfd_secret
+  int fd = syscall(SYS_memfd_secret, O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  if (ftruncate(fd, secret.size()) != 0) {
+    close(fd);
+    return -1;
+  }
+  if (!secret.empty()) {
+    void* data = mmap(NULL, secret.size(), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+    memcpy(data, secret.data(), secret.size());
+    munmap(data, secret.size());
+  }
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+}  // namespace
+
+KEYTAR_OP_RESULT CreateSecretFd(const std::string& secret,
+                                int* fd,
+                                bool* secretMemory,
+                                std::string* error) {
+  *fd = CreateSecretMemory(secret);
+  *secretMemory = *fd >= 0;
+  if (*secretMemory)
+    return SUCCESS;
+
+  *fd = memfd_create(kMemfdName, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (*fd < 0)
+    return SystemError("memfd_create", error);
+
+  size_t written = 0;
+  while (written < secret.size()) {
+    ssize_t n = write(*fd, secret.data() + written, secret.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      SystemError("write", error);
+      close(*fd);
+      return FAIL_ERROR;
+    }
+    written += n;
+  }
+
+  // The child gets a read-only view of exactly these bytes.
+  if (fcntl(*fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+    SystemError("fcntl(F_ADD_SEALS)", error);
+    close(*fd);
+    return FAIL_ERROR;
+  }
+  return SUCCESS;
+}
+
+KEYTAR_OP_RESULT ReadSecretFd(int fd, std::string* secret, std::string* error) {
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    SystemError("fstat", error);
+    close(fd);
+    return FAIL_ERROR;
+  }
+
+  secret->clear();
+  if (info.st_size > 0) {
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      SystemError("mmap", error);
+      close(fd);
+      return FAIL_ERROR;
+    }
+    secret->assign(static_cast<const char*>(data), info.st_size);
+    munmap(data, info.st_size);
+  }
+  close(fd);
+  return SUCCESS;
+}
+
+#else  // !__linux__
+
+namespace {
+
+const char kUnsupported[] =
+  "Passing secrets through memory files is only supported on Linux";
+
+}  // namespace
+
+KEYTAR_OP_RESULT CreateSecretFd(const std::string& secret,
+                                int* fd,
+                                bool* secretMemory,
+                                std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+KEYTAR_OP_RESULT ReadSecretFd(int fd, std::string* secret, std::string* error) {
+  *error = kUnsupported;
+  return FAIL_ERROR;
+}
+
+#endif  // __linux__
+
+}  // namespace keytar
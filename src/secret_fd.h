@@ -0,0 +1,31 @@
+#ifndef SRC_SECRET_FD_H_
+#define SRC_SECRET_FD_H_
+
+#include <string>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// Anonymous in-memory files for handing a secret to a child process as an
+// inherited descriptor, without a copy on the V8 heap, in the environment
+// or in a pipe buffer. Linux only; elsewhere both calls fail.
+
+// Creates a file holding `secret` and stores its descriptor in `fd`. Uses
+// memfd_secret(2), whose pages are unmapped from the kernel's direct map,
+// when the kernel allows it, and otherwise a memfd sealed against writes
+// and resizing. `secretMemory` tells which one was made. The descriptor is
+// close-on-exec; child_process.spawn's stdio option clears that on the copy
+// it gives the child.
+KEYTAR_OP_RESULT CreateSecretFd(const std::string& secret,
+                                int* fd,
+                                bool* secretMemory,
+                                std::string* error);
+
+// Reads the whole file behind `fd` and closes it. Reads by mapping the
+// file, since memfd_secret(2) files can't be read(2).
+KEYTAR_OP_RESULT ReadSecretFd(int fd, std::string* secret, std::string* error);
+
+}  // namespace keytar
+
+#endif  // SRC_SECRET_FD_H_
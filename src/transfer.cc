@@ -0,0 +1,391 @@
+#include "transfer.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <string>
+#include <vector>
+
+#include "agent_client.h"
+#include "credentials.h"
+#include "preload.h"
+
+namespace keytar {
+
+namespace {
+
+const char kMagic[] = { 'K', 'T', 'X', '1' };
+const uint8_t kVersion = 1;
+const size_t kSaltSize = 16;
+const size_t kHeaderSize = sizeof(kMagic) + 4 + kSaltSize;
+const size_t kNonceSize = 12;
+const size_t kTagSize = 16;
+
+// Upper bound on a sealed record, so a corrupt length prefix can't make the
+// importer buffer arbitrary amounts of input.
+const size_t kMaxSealedSize = 16 * 1024 * 1024;
+
+// Record types; the first plaintext byte.
+const uint8_t kRecordEntry = 1;
+const uint8_t kRecordEnd = 2;
+
+// Entry flags.
+const uint8_t kFlagBinary = 1 << 0;
+
+const char kKeyLabel[] = "keytar export v1";
+
+void PutUint(std::string* out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint64_t GetUint(const std::string& in, size_t offset, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(
+      static_cast<unsigned char>(in[offset + i])) << (8 * i);
+  }
+  return value;
+}
+
+void PutBytes(std::string* out, const std::string& value) {
+  PutUint(out, value.size(), 4);
+  out->append(value);
+}
+
+bool GetBytes(const std::string& in, size_t* offset, std::string* value) {
+  if (in.size() - *offset < 4)
+    return false;
+  size_t length = GetUint(in, *offset, 4);
+  *offset += 4;
+  if (in.size() - *offset < length)
+    return false;
+  value->assign(in, *offset, length);
+  *offset += length;
+  return true;
+}
+
+// Overwrites a string that held secret material before it is released.
+void Wipe(std::string* value) {
+  if (!value->empty())
+    OPENSSL_cleanse(&(*value)[0], value->size());
+  value->clear();
+}
+
+// Derives the key of one stream from the caller's key and the stream salt.
+std::string DeriveKey(const std::string& key, const std::string& salt) {
+  std::string message(kKeyLabel, sizeof(kKeyLabel) - 1);
+  message.append(salt);
+  unsigned char derived[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  HMAC(EVP_sha256(),
+       key.data(), static_cast<int>(key.size()),
+       reinterpret_cast<const unsigned char*>(message.data()), message.size(),
+       derived, &length);
+  std::string result(reinterpret_cast<char*>(derived), length);
+  OPENSSL_cleanse(derived, sizeof(derived));
+  return result;
+}
+
+std::string Nonce(uint64_t record) {
+  std::string nonce(kNonceSize - 8, '\0');
+  PutUint(&nonce, record, 8);
+  return nonce;
+}
+
+std::string AdditionalData(const std::string& header, uint64_t record) {
+  std::string aad(header);
+  PutUint(&aad, record, 8);
+  return aad;
+}
+
+// Runs AES-256-GCM over `input`. When sealing, the tag is appended to
+// `output`; when opening, it is taken from the end of `input`.
+bool Crypt(bool seal,
+           const std::string& key,
+           const std::string& nonce,
+           const std::string& aad,
+           const std::string& input,
+           std::string* output) {
+  size_t length = seal ? input.size() : input.size() - kTagSize;
+  const unsigned char* in =
+    reinterpret_cast<const unsigned char*>(input.data());
+  std::vector<unsigned char> out(length + kTagSize);
+  int outLength = 0;
+  int finalLength = 0;
+
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if (ctx == NULL)
+    return false;
+
+  const unsigned char* k = reinterpret_cast<const unsigned char*>(key.data());
+  const unsigned char* iv =
+    reinterpret_cast<const unsigned char*>(nonce.data());
+  bool ok = EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, k, iv,
+                              seal ? 1 : 0) == 1 &&
+    EVP_CipherUpdate(ctx, NULL, &outLength,
+                     reinterpret_cast<const unsigned char*>(aad.data()),
+                     static_cast<int>(aad.size())) == 1 &&
+    EVP_CipherUpdate(ctx, out.data(), &outLength, in,
+                     static_cast<int>(length)) == 1;
+  if (ok && !seal) {
+    ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kTagSize,
+                             const_cast<unsigned char*>(in + length)) == 1;
+  }
+  ok = ok && EVP_CipherFinal_ex(ctx, out.data() + outLength,
+                                &finalLength) == 1;
+  if (ok && seal) {
+    ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kTagSize,
+                             out.data() + length) == 1;
+  }
+  EVP_CIPHER_CTX_free(ctx);
+
+  if (ok) {
+    output->assign(reinterpret_cast<char*>(out.data()),
+                   seal ? length + kTagSize : length);
+  }
+  OPENSSL_cleanse(out.data(), out.size());
+  return ok;
+}
+
+}  // namespace
+
+Exporter::Exporter(const std::string& service, const std::string& key)
+  : service(service),
+    key(key),
+    nextAccount(0),
+    nextRecord(0),
+    entries(0),
+    started(false),
+    finished(false) {
+}
+
+Exporter::~Exporter() {
+  Wipe(&key);
+}
+
+bool Exporter::Seal(const std::string& plaintext,
+                    std::string* out,
+                    std::string* error) {
+  std::string sealed;
+  if (!Crypt(true, key, Nonce(nextRecord),
+             AdditionalData(header, nextRecord), plaintext, &sealed)) {
+    *error = "Failed to encrypt export record";
+    return false;
+  }
+  ++nextRecord;
+  PutUint(out, sealed.size(), 4);
+  out->append(sealed);
+  return true;
+}
+
+KEYTAR_OP_RESULT Exporter::Next(size_t batchSize,
+                                std::string* out,
+                                std::string* error) {
+  if (finished)
+    return FAIL_NONFATAL;
+
+  if (!started) {
+    // Only the account names are held in memory; secrets are read one at a
+    // time as records are produced. No backend can enumerate a page at a
+    // time, so the names of the whole service are, which is O(accounts).
+    std::vector<Credentials> credentials;
+    KEYTAR_OP_RESULT result = FindCredentials(service, &credentials, error);
+    if (result == FAIL_ERROR)
+      return FAIL_ERROR;
+    for (size_t i = 0; i < credentials.size(); ++i)
+      accounts.push_back(std::get<1>(credentials[i]));
+
+    unsigned char salt[kSaltSize];
+    if (RAND_bytes(salt, sizeof(salt)) != 1) {
+      *error = "Failed to generate export salt";
+      return FAIL_ERROR;
+    }
+    header.assign(kMagic, sizeof(kMagic));
+    PutUint(&header, kVersion, 1);
+    PutUint(&header, 0, 3);
+    header.append(reinterpret_cast<char*>(salt), sizeof(salt));
+    std::string derived = DeriveKey(key, header.substr(header.size() - kSaltSize));
+    Wipe(&key);
+    key = derived;
+    Wipe(&derived);
+
+    out->append(header);
+    started = true;
+  }
+
+  while (nextAccount < accounts.size() && out->size() < batchSize) {
+    const std::string& account = accounts[nextAccount++];
+
+    // Prefer the text API so that text entries are restored as text; the
+    // binary API reads entries that aren't.
+    uint8_t flags = 0;
+    std::string secret;
+    KEYTAR_OP_RESULT result = GetPassword(service, account, &secret, error);
+    if (result == FAIL_NONFATAL) {
+      flags |= kFlagBinary;
+      result = GetPasswordBinary(service, account, &secret, error);
+    }
+    if (result == FAIL_ERROR)
+      return FAIL_ERROR;
+    if (result == FAIL_NONFATAL)
+      continue;  // Deleted since the accounts were listed.
+
+    std::string plaintext;
+    PutUint(&plaintext, kRecordEntry, 1);
+    PutUint(&plaintext, flags, 1);
+    PutBytes(&plaintext, service);
+    PutBytes(&plaintext, account);
+    PutBytes(&plaintext, secret);
+    Wipe(&secret);
+
+    bool sealed = Seal(plaintext, out, error);
+    Wipe(&plaintext);
+    if (!sealed)
+      return FAIL_ERROR;
+    ++entries;
+  }
+
+  if (nextAccount == accounts.size() && out->size() < batchSize) {
+    std::string plaintext;
+    PutUint(&plaintext, kRecordEnd, 1);
+    PutUint(&plaintext, entries, 8);
+    if (!Seal(plaintext, out, error))
+      return FAIL_ERROR;
+    finished = true;
+    Wipe(&key);
+  }
+
+  return SUCCESS;
+}
+
+Importer::Importer(const std::string& key)
+  : key(key),
+    nextRecord(0),
+    entries(0),
+    finished(false) {
+}
+
+Importer::~Importer() {
+  Wipe(&key);
+  Wipe(&pending);
+}
+
+bool Importer::Open(const std::string& sealed,
+                    std::string* plaintext,
+                    std::string* error) {
+  if (sealed.size() < kTagSize ||
+      !Crypt(false, key, Nonce(nextRecord),
+             AdditionalData(header, nextRecord), sealed, plaintext)) {
+    *error = "Export record failed authentication; wrong key or corrupt data";
+    return false;
+  }
+  ++nextRecord;
+  return true;
+}
+
+KEYTAR_OP_RESULT Importer::Store(const std::string& plaintext,
+                                 std::string* error) {
+  if (!plaintext.empty() && GetUint(plaintext, 0, 1) == kRecordEnd) {
+    if (plaintext.size() != 9 || GetUint(plaintext, 1, 8) != entries) {
+      *error = "Export is missing entries";
+      return FAIL_ERROR;
+    }
+    finished = true;
+    return SUCCESS;
+  }
+
+  size_t offset = 2;
+  std::string service;
+  std::string account;
+  std::string secret;
+  if (plaintext.size() < offset ||
+      GetUint(plaintext, 0, 1) != kRecordEntry ||
+      !GetBytes(plaintext, &offset, &service) ||
+      !GetBytes(plaintext, &offset, &account) ||
+      !GetBytes(plaintext, &offset, &secret) ||
+      offset != plaintext.size()) {
+    *error = "Malformed export record";
+    return FAIL_ERROR;
+  }
+
+  KEYTAR_OP_RESULT result;
+  if (GetUint(plaintext, 1, 1) & kFlagBinary)
+    result = SetPasswordBinary(service, account, secret, error);
+  else
+    result = SetPassword(service, account, secret, error);
+  InvalidatePreloaded(service, account);
+  agent::Invalidate(service);
+  Wipe(&secret);
+  if (result == SUCCESS)
+    ++entries;
+  return result;
+}
+
+KEYTAR_OP_RESULT Importer::Write(const std::string& data,
+                                 std::string* error) {
+  if (finished) {
+    *error = "Unexpected data after the end of the export";
+    return FAIL_ERROR;
+  }
+  pending.append(data);
+
+  if (header.empty()) {
+    if (pending.size() < kHeaderSize)
+      return SUCCESS;
+    if (pending.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0 ||
+        GetUint(pending, sizeof(kMagic), 1) != kVersion) {
+      *error = "Not a keytar export, or an unsupported version";
+      return FAIL_ERROR;
+    }
+    header = pending.substr(0, kHeaderSize);
+    pending.erase(0, kHeaderSize);
+    std::string derived = DeriveKey(key, header.substr(kHeaderSize - kSaltSize));
+    Wipe(&key);
+    key = derived;
+    Wipe(&derived);
+  }
+
+  size_t offset = 0;
+  KEYTAR_OP_RESULT result = SUCCESS;
+  while (result == SUCCESS && pending.size() - offset >= 4) {
+    size_t length = GetUint(pending, offset, 4);
+    if (length > kMaxSealedSize) {
+      *error = "Malformed export record";
+      result = FAIL_ERROR;
+      break;
+    }
+    if (pending.size() - offset - 4 < length)
+      break;
+
+    std::string plaintext;
+    if (!Open(pending.substr(offset + 4, length), &plaintext, error)) {
+      result = FAIL_ERROR;
+      break;
+    }
+    offset += 4 + length;
+    result = Store(plaintext, error);
+    Wipe(&plaintext);
+    if (finished && result == SUCCESS && offset != pending.size()) {
+      *error = "Unexpected data after the end of the export";
+      result = FAIL_ERROR;
+    }
+  }
+
+  OPENSSL_cleanse(&pending[0], offset);
+  pending.erase(0, offset);
+  return result;
+}
+
+KEYTAR_OP_RESULT Importer::Finish(std::string* error) {
+  if (!finished) {
+    *error = "Export is truncated";
+    return FAIL_ERROR;
+  }
+  return SUCCESS;
+}
+
+}  // namespace keytar
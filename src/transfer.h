@@ -0,0 +1,85 @@
+#ifndef SRC_TRANSFER_H_
+#define SRC_TRANSFER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "keytar.h"
+
+namespace keytar {
+
+// Size of the key taken by Exporter and Importer (AES-256).
+const size_t kTransferKeySize = 32;
+
+// Produces an encrypted export of every entry of one service, a batch of
+// records at a time, so secrets are never all held in memory. Account names
+// are, since the backends can only enumerate a service in one go.
+//
+// Stream layout, all integers little-endian:
+//   magic "KTX1" | version u8 | reserved u8[3] | salt u8[16]
+// followed by records of
+//   sealed length u32 | AES-256-GCM ciphertext | tag u8[16]
+// Each stream is encrypted with its own key derived from the caller's key
+// and the salt. Record i uses nonce i and authenticates the header and i,
+// so records can't be reordered, dropped or moved between streams. The last
+// record holds the entry count, so truncation is detected as well.
+class Exporter {
+  public:
+    Exporter(const std::string& service, const std::string& key);
+    ~Exporter();
+
+    // Appends the next records to `out`, stopping once it holds at least
+    // `batchSize` bytes. Returns FAIL_NONFATAL once the stream is complete.
+    KEYTAR_OP_RESULT Next(size_t batchSize, std::string* out,
+                          std::string* error);
+
+    uint64_t count() const { return entries; }
+
+  private:
+    bool Seal(const std::string& plaintext, std::string* out,
+              std::string* error);
+
+    const std::string service;
+    std::string key;
+    std::string header;
+    std::vector<std::string> accounts;
+    size_t nextAccount;
+    uint64_t nextRecord;
+    uint64_t entries;
+    bool started;
+    bool finished;
+};
+
+// Consumes a stream produced by Exporter in arbitrarily sized pieces and
+// stores each entry as soon as its record is complete.
+class Importer {
+  public:
+    explicit Importer(const std::string& key);
+    ~Importer();
+
+    // Decrypts and stores every record completed by `data`.
+    KEYTAR_OP_RESULT Write(const std::string& data, std::string* error);
+
+    // Fails unless the stream ended exactly after its final record.
+    KEYTAR_OP_RESULT Finish(std::string* error);
+
+    uint64_t count() const { return entries; }
+
+  private:
+    bool Open(const std::string& sealed, std::string* plaintext,
+              std::string* error);
+    KEYTAR_OP_RESULT Store(const std::string& plaintext, std::string* error);
+
+    std::string key;
+    std::string header;
+    std::string pending;
+    uint64_t nextRecord;
+    uint64_t entries;
+    bool finished;
+};
+
+}  // namespace keytar
+
+#endif  // SRC_TRANSFER_H_
@@ -0,0 +1,102 @@
+#include "transfer_cursor.h"
+
+#include <string>
+
+#include "async.h"
+
+namespace {
+
+// Bytes of records produced per call to ExportCursor#next.
+const size_t kExportBatchSize = 64 * 1024;
+
+// Copies a key argument, which lib/keytar.js has checked to be a Buffer of
+// keytar::kTransferKeySize bytes.
+std::string KeyArgument(v8::Local<v8::Value> value) {
+  return std::string(node::Buffer::Data(value), node::Buffer::Length(value));
+}
+
+}  // namespace
+
+ExportCursor::ExportCursor(const std::string& service, const std::string& key)
+  : exporter(service, key) {
+}
+
+ExportCursor::~ExportCursor() {
+}
+
+void ExportCursor::Init(v8::Local<v8::Object> exports) {
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("ExportCursor").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Nan::SetPrototypeMethod(tpl, "next", Next);
+  Nan::SetPrototypeMethod(tpl, "count", Count);
+  Nan::Set(exports,
+           Nan::New("ExportCursor").ToLocalChecked(),
+           Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+NAN_METHOD(ExportCursor::New) {
+  ExportCursor* cursor = new ExportCursor(*v8::String::Utf8Value(info[0]),
+                                          KeyArgument(info[1]));
+  cursor->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(ExportCursor::Next) {
+  ExportCursor* cursor = Nan::ObjectWrap::Unwrap<ExportCursor>(info.Holder());
+  ExportNextWorker* worker = new ExportNextWorker(
+    &cursor->exporter,
+    kExportBatchSize,
+    new Nan::Callback(info[0].As<v8::Function>()));
+  worker->SaveToPersistent("cursor", info.Holder());
+  worker->Queue();
+}
+
+NAN_METHOD(ExportCursor::Count) {
+  ExportCursor* cursor = Nan::ObjectWrap::Unwrap<ExportCursor>(info.Holder());
+  info.GetReturnValue().Set(static_cast<double>(cursor->exporter.count()));
+}
+
+ImportCursor::ImportCursor(const std::string& key)
+  : importer(key) {
+}
+
+ImportCursor::~ImportCursor() {
+}
+
+void ImportCursor::Init(v8::Local<v8::Object> exports) {
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("ImportCursor").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Nan::SetPrototypeMethod(tpl, "write", Write);
+  Nan::SetPrototypeMethod(tpl, "finish", Finish);
+  Nan::Set(exports,
+           Nan::New("ImportCursor").ToLocalChecked(),
+           Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+NAN_METHOD(ImportCursor::New) {
+  ImportCursor* cursor = new ImportCursor(KeyArgument(info[0]));
+  cursor->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(ImportCursor::Write) {
+  ImportCursor* cursor = Nan::ObjectWrap::Unwrap<ImportCursor>(info.Holder());
+  ImportWriteWorker* worker = new ImportWriteWorker(
+    &cursor->importer,
+    std::string(node::Buffer::Data(info[0]), node::Buffer::Length(info[0])),
+    new Nan::Callback(info[1].As<v8::Function>()));
+  worker->SaveToPersistent("cursor", info.Holder());
+  worker->Queue();
+}
+
+NAN_METHOD(ImportCursor::Finish) {
+  ImportCursor* cursor = Nan::ObjectWrap::Unwrap<ImportCursor>(info.Holder());
+  std::string error;
+  if (cursor->importer.Finish(&error) != keytar::SUCCESS) {
+    Nan::ThrowError(error.c_str());
+    return;
+  }
+  info.GetReturnValue().Set(static_cast<double>(cursor->importer.count()));
+}
@@ -0,0 +1,40 @@
+#ifndef SRC_TRANSFER_CURSOR_H_
+#define SRC_TRANSFER_CURSOR_H_
+
+#include "nan.h"
+#include "transfer.h"
+
+// JS handles for an in-progress export or import. lib/keytar.js drives them
+// one call at a time, so each cursor has at most one worker running on it.
+
+class ExportCursor : public Nan::ObjectWrap {
+  public:
+    static void Init(v8::Local<v8::Object> exports);
+
+  private:
+    ExportCursor(const std::string& service, const std::string& key);
+    ~ExportCursor();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Next);
+    static NAN_METHOD(Count);
+
+    keytar::Exporter exporter;
+};
+
+class ImportCursor : public Nan::ObjectWrap {
+  public:
+    static void Init(v8::Local<v8::Object> exports);
+
+  private:
+    explicit ImportCursor(const std::string& key);
+    ~ImportCursor();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Write);
+    static NAN_METHOD(Finish);
+
+    keytar::Importer importer;
+};
+
+#endif  // SRC_TRANSFER_CURSOR_H_